@@ -8,19 +8,60 @@
 #ifndef INC_NRF24L01_H_
 #define INC_NRF24L01_H_
 
+#include <stdint.h>
 
+/* SPI bus and pins of the radio, see nrf24_hal.h for the HAL backend or a mock for host tests.
+ * ctx is nrf24_inst.ops_ctx */
+typedef struct
+{
+	void (*transfer)(void *ctx, const uint8_t *tx, uint8_t *rx, uint16_t size); /* tx or rx may be NULL */
+	void (*csn)(void *ctx, uint8_t level);
+	void (*ce)(void *ctx, uint8_t level);
+	void (*delay_ms)(void *ctx, uint32_t ms);
+}nrf24_spi_ops;
 
+typedef enum
+{
+	NRF24_MODE_POWER_DOWN = 0,
+	NRF24_MODE_TX,
+	NRF24_MODE_RX
+}nrf24_mode;
 
-void NRF24_Init (void);
+typedef struct{
+	uint8_t              address[5];  /* TX address in Tx mode, pipe 1 (base) address in Rx mode */
+	uint8_t              channel;     /* RF channel */
+	const nrf24_spi_ops *ops;         /* SPI backend of the radio */
+	void                *ops_ctx;
+	/* driver state */
+	nrf24_mode           mode;
+	uint8_t              shadow_reg[32];    /* copy of the configuration registers */
+	uint32_t             shadow_valid;      /* bit n set when shadow_reg[n] matches the chip */
+	uint8_t              shadow_addr[3][5]; /* RX_ADDR_P0, RX_ADDR_P1, TX_ADDR */
+	uint8_t              shadow_addr_valid;
+}nrf24_inst;
 
-void NRF24_TxMode (uint8_t *Address, uint8_t channel);
-uint8_t NRF24_Transmit (uint8_t *data);
 
-void NRF24_RxMode (uint8_t *Address, uint8_t channel);
-uint8_t isDataAvailable (int pipenum);
-void NRF24_Receive (uint8_t *data);
+void NRF24_Init (nrf24_inst *nrf);
 
-void NRF24_ReadAll (uint8_t *data);
+void NRF24_TxMode (nrf24_inst *nrf);
+uint8_t NRF24_Transmit (nrf24_inst *nrf, uint8_t *data);
+
+void NRF24_RxMode (nrf24_inst *nrf);
+void NRF24_OpenRxPipe (nrf24_inst *nrf, int pipenum, const uint8_t *Address, uint8_t width);
+uint8_t NRF24_RxPipe (nrf24_inst *nrf);
+uint8_t isDataAvailable (nrf24_inst *nrf, int pipenum);
+void NRF24_Receive (nrf24_inst *nrf, uint8_t *data);
+
+void NRF24_ReadAll (nrf24_inst *nrf, uint8_t *data);
+
+void NRF24_EnableDynamicPayload (nrf24_inst *nrf, uint8_t pipemask);
+void NRF24_EnableAckPayload (nrf24_inst *nrf);
+uint8_t NRF24_RxFifoEmpty (nrf24_inst *nrf);
+uint8_t NRF24_ReceiveDynamic (nrf24_inst *nrf, uint8_t *data);
+uint8_t NRF24_ReceiveWidth (nrf24_inst *nrf, uint8_t *data, uint8_t width);
+uint8_t NRF24_WriteAckPayload (nrf24_inst *nrf, int pipenum, const uint8_t *data, uint8_t size);
+
+uint8_t NRF24_Verify (nrf24_inst *nrf, uint8_t repair);
 
 /* Memory Map */
 #define CONFIG      0x00
@@ -0,0 +1,35 @@
+/*
+ * byte_ring.h
+ *
+ *  Byte ring buffer behind the RX and TX sides of the micro-ROS UART transport (dma_transport.c).
+ *  It has no HAL or RTOS dependency, so it also builds on a host against a simulated UART/DMA.
+ *
+ *  head and tail are free running byte counters, the buffer size is a power of two. One side writes,
+ *  the other reads; the caller masks interrupts when both sides can run in the same direction.
+ *  For a ring filled by a circular DMA, byte_ring_dma_update turns the DMA position into head, and a
+ *  writer lapping the reader shows up as byte_ring_used > size.
+ */
+
+#ifndef INC_BYTE_RING_H_
+#define INC_BYTE_RING_H_
+
+#include <stdint.h>
+
+typedef struct{
+	uint8_t *buffer;
+	uint32_t size;              /* power of two */
+	volatile uint32_t head;     /* bytes written */
+	volatile uint32_t tail;     /* bytes read */
+	volatile uint32_t dma_pos;  /* last DMA position seen by byte_ring_dma_update */
+}byte_ring;
+
+void byte_ring_init(byte_ring *ring, uint8_t *buffer, uint32_t size);
+uint32_t byte_ring_used(const byte_ring *ring);
+uint32_t byte_ring_free(const byte_ring *ring);
+uint32_t byte_ring_write(byte_ring *ring, const uint8_t *data, uint32_t len);
+uint32_t byte_ring_read(byte_ring *ring, uint8_t *data, uint32_t len);
+uint32_t byte_ring_linear(const byte_ring *ring, uint8_t **data);
+void byte_ring_skip(byte_ring *ring, uint32_t len);
+uint32_t byte_ring_dma_update(byte_ring *ring, uint32_t pos);
+
+#endif /* INC_BYTE_RING_H_ */
@@ -0,0 +1,50 @@
+/*
+ * command_mux.h
+ *
+ *  Arbitration between the command sources (radio pipes, ROS topics, local test patterns). Every
+ *  source submits timestamped wheel setpoints into its own mailbox, a submission holds for the lease
+ *  of the source. At each control tick the mux selects the live source with the highest priority
+ *  and outputs its setpoints, the only path to the wheel targets.
+ */
+
+#ifndef INC_COMMAND_MUX_H_
+#define INC_COMMAND_MUX_H_
+
+#include <stdint.h>
+#include "wheel_command.h"
+
+#define COMMAND_MUX_NONE       (-1)  /* no live source, the motors are stopped */
+
+/* command_mux_tick result bits */
+#define COMMAND_MUX_CHANGED    0x01  /* new output */
+#define COMMAND_MUX_TRANSITION 0x02  /* the active source changed */
+
+typedef struct{
+	const char *name;
+	uint8_t priority;         /* higher value wins */
+	uint16_t lease_ms;        /* a submission holds for this long */
+	float ramp_rpm_per_s;     /* 0 to release at the end of the lease, else ramp the setpoints to zero first */
+	wheel_mailbox box;        /* written by the single producer of the source */
+	/* state of the mux */
+	wheel_setpoint last;
+	float ramp[WHEEL_COUNT];
+	uint8_t ramping;
+	uint32_t activations;     /* times the source became active */
+}command_source;
+
+typedef struct{
+	command_source *sources;
+	uint8_t count;
+	int8_t active;            /* index of the active source or COMMAND_MUX_NONE */
+	int8_t previous;          /* source active before the last transition */
+	uint32_t applied_seq;     /* submission of the active source in output */
+	uint32_t last_tick_ms;
+	uint32_t transitions;
+	float output[WHEEL_COUNT];
+}command_mux;
+
+void command_mux_init(command_mux *mux, command_source *sources, uint8_t count);
+void command_mux_submit(command_source *source, const float wheel[WHEEL_COUNT], uint32_t now_ms);
+uint8_t command_mux_tick(command_mux *mux, uint32_t now_ms);
+
+#endif /* INC_COMMAND_MUX_H_ */
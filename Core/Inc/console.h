@@ -0,0 +1,35 @@
+/*
+ * console.h
+ *
+ *  Non-blocking diagnostic console: printf output is queued in a ring buffer and sent by the DMA
+ *  on its own UART, so it never shares the micro-ROS link and never stalls the caller.
+ */
+
+#ifndef INC_CONSOLE_H_
+#define INC_CONSOLE_H_
+
+#include "main.h"
+
+#define CONSOLE_BUFFER_SIZE 1024 /* power of two */
+
+typedef struct{
+	uint32_t bytes;          /* bytes queued */
+	uint32_t dropped_bytes;  /* bytes discarded because the ring was full */
+	uint32_t dropped_writes; /* writes discarded, a write is queued whole or not at all */
+}console_stats;
+
+typedef struct{
+	UART_HandleTypeDef *huart;                 /* uart with a DMA TX stream and its interrupt enabled */
+	uint8_t buffer[CONSOLE_BUFFER_SIZE];
+	volatile uint32_t head;                    /* free running, advanced by the writers */
+	volatile uint32_t tail;                    /* free running, advanced when the DMA is done */
+	volatile uint16_t in_flight;               /* length of the chunk being sent */
+	console_stats stats;
+}console_inst;
+
+void console_init(console_inst *console, UART_HandleTypeDef *huart);
+uint16_t console_write(console_inst *console, const uint8_t *data, uint16_t len);
+uint16_t console_free(console_inst *console);
+void console_tx_complete(console_inst *console);
+
+#endif /* INC_CONSOLE_H_ */
@@ -0,0 +1,35 @@
+/*
+ * critical.h
+ *
+ *  Short critical sections shared by tasks and interrupts. They mask every interrupt through
+ *  PRIMASK rather than taking an RTOS mutex: the protected sections copy a few words, they run
+ *  from interrupts as well as tasks, and before the scheduler starts. critical_exit restores the
+ *  previous mask, so the sections nest and are safe to enter with interrupts already masked.
+ *  Keep them to bounded copies, they delay every interrupt including the 2 kHz control timer (TIM5).
+ */
+
+#ifndef INC_CRITICAL_H_
+#define INC_CRITICAL_H_
+
+#include "main.h"
+
+/*	@brief mask the interrupts
+ * 	@retval: previous mask, to hand to critical_exit
+ * */
+static inline uint32_t critical_enter(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	return primask;
+}
+
+/*	@brief restore the interrupt mask saved by critical_enter
+ * 	@param primask: value returned by critical_enter
+ * 	@retval: none
+ * */
+static inline void critical_exit(uint32_t primask)
+{
+	__set_PRIMASK(primask);
+}
+
+#endif /* INC_CRITICAL_H_ */
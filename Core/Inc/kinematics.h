@@ -0,0 +1,21 @@
+/*
+ * kinematics.h
+ *
+ *  Skid-steer kinematics of the rover: body twist to wheel setpoints. Wheels a and c are on the
+ *  right side, b and d on the left.
+ */
+
+#ifndef INC_KINEMATICS_H_
+#define INC_KINEMATICS_H_
+
+#include "motor_encoder.h"
+#include "wheel_command.h"
+
+#define WHEEL_CIRCUMFERENCE_M (ONE_REV_LENGTH_CM / 100.0f) /* 2 pi RADIUS */
+#define TRACK_WIDTH_M         0.40f  /* between the left and right wheel contact lines */
+#define WHEEL_MAX_RPM         68.0f  /* top of the velocity to duty table */
+
+void twist_to_wheels(float linear_mps, float angular_rps, float wheel_rpm[WHEEL_COUNT]);
+uint8_t ramp_to_zero(float wheel_rpm[WHEEL_COUNT], float max_step_rpm);
+
+#endif /* INC_KINEMATICS_H_ */
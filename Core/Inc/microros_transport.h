@@ -0,0 +1,46 @@
+/*
+ * microros_transport.h
+ *
+ *  Hooks and health counters of the micro-ROS UART transport (microros_transports/dma_transport.c).
+ *  The transport itself is registered with rmw_uros_set_custom_transport in main.c.
+ */
+
+#ifndef INC_MICROROS_TRANSPORT_H_
+#define INC_MICROROS_TRANSPORT_H_
+
+#include "main.h"
+#include <stddef.h>
+
+typedef struct{
+	uint32_t bytes_in;
+	uint32_t bytes_out;
+	uint32_t reads;               /* reads that returned data */
+	uint32_t read_timeouts;       /* reads that returned nothing */
+	uint32_t rx_overruns;         /* received data lost because the RX ring was lapped or full */
+	uint32_t tx_rejects;          /* writes refused because the TX side stayed busy */
+	uint32_t framing_errors;      /* UART line errors */
+	uint32_t noise_errors;
+	uint32_t parity_errors;
+	uint32_t uart_overruns;       /* byte lost in the UART before the DMA read it */
+	uint32_t dma_errors;
+	uint32_t read_latency_min_us; /* time a read waited before data was available */
+	uint32_t read_latency_avg_us; /* moving average, new samples weigh 1/16 */
+	uint32_t read_latency_max_us;
+	uint16_t tx_queue_depth;      /* bytes waiting to be sent after the last write */
+	uint16_t tx_queue_max;
+}transport_stats;
+
+const transport_stats *cubemx_transport_get_stats(void);
+void cubemx_transport_reset_stats(void);
+
+/* shared bookkeeping, transport_stats.c */
+uint32_t transport_stats_now(void);
+void transport_stats_read(transport_stats *stats, uint32_t start, size_t len);
+void transport_stats_write(transport_stats *stats, size_t len, uint32_t queued);
+
+/* USART transport (dma_transport.c), called from the HAL UART callbacks */
+void cubemx_transport_rx_event(UART_HandleTypeDef * uart);
+void cubemx_transport_tx_complete(UART_HandleTypeDef * uart);
+void cubemx_transport_error(UART_HandleTypeDef * uart);
+
+#endif /* INC_MICROROS_TRANSPORT_H_ */
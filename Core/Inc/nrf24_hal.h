@@ -0,0 +1,25 @@
+/*
+ * nrf24_hal.h
+ *
+ *  SPI backend of the NRF24 driver on the STM32 HAL: the SPI handle and the CE/CSN pins of one radio.
+ *  The driver itself only goes through nrf24_spi_ops, so it also builds on a host against a mock bus.
+ */
+
+#ifndef INC_NRF24_HAL_H_
+#define INC_NRF24_HAL_H_
+
+#include "main.h"
+#include "NRF24L01.h"
+
+typedef struct{
+	SPI_HandleTypeDef *hspi;      /* SPI bus of the radio */
+	GPIO_TypeDef      *ce_port;   /* chip enable pin */
+	uint16_t           ce_pin;
+	GPIO_TypeDef      *csn_port;  /* SPI chip select pin */
+	uint16_t           csn_pin;
+}nrf24_hal_bus;
+
+/* ops of nrf24_inst, with an nrf24_hal_bus as ops_ctx */
+extern const nrf24_spi_ops nrf24_hal_ops;
+
+#endif /* INC_NRF24_HAL_H_ */
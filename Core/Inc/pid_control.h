@@ -15,6 +15,15 @@ typedef struct
 	float integral_max; /* Maximum of the error integral */
 	float pid_max; /* Maximum of the PID */
 }pid_instance;
+/* tunable part of a pid_instance */
+typedef struct
+{
+	float p_gain;
+	float i_gain;
+	float d_gain;
+	float integral_max;
+	float pid_max;
+}pid_config;
 typedef enum
 {
 	pid_ok = 0,
@@ -29,7 +38,11 @@ typedef struct {
 pid_typedef apply_pid(pid_instance *pid, float input_error);
 void reset_pid(pid_instance *pid);
 void set_pid(pid_instance *pid, float p, float i, float d);
+void get_pid_config(const pid_instance *pid, pid_config *config);
+void configure_pid(pid_instance *pid, const pid_config *config);
 
 float get_pwm_from_velocity(float desired_velocity);
+void set_pwm_table_gain(float gain);
+float get_pwm_table_gain(void);
 
 #endif /* INC_PID_CONTROL_H_ */
@@ -0,0 +1,45 @@
+/*
+ * radio_link.h
+ *
+ *  Receive side of the NRF24 link: every data pipe is a separate command source
+ *  (operator, autonomy base station, safety stop, ...) with its own address, payload width,
+ *  frame decoder and statistics.
+ */
+
+#ifndef INC_RADIO_LINK_H_
+#define INC_RADIO_LINK_H_
+
+#include <stdint.h>
+#include "radio_protocol.h"
+#include "NRF24L01.h"
+
+#define RADIO_PIPES    6
+
+typedef struct
+{
+	uint32_t packets;          /* payloads read from the pipe */
+	uint32_t bytes;
+	uint32_t rejected;         /* binary frames refused by radio_decode */
+	uint32_t last_command_ms;  /* local time of the last command passed to the handler */
+} radio_source_stats;
+
+typedef struct
+{
+	const char *name;
+	uint8_t pipe;            /* 0..5 */
+	uint8_t address[5];      /* full address for pipes 0 and 1, only address[0] for pipes 2 to 5 */
+	uint8_t width;           /* fixed payload width without auto acknowledge, 0 for dynamic payload length */
+	uint8_t ack_telemetry;   /* send the telemetry back in the ACK payload of this pipe */
+	radio_decoder decoder;
+	radio_source_stats stats;
+} radio_source;
+
+/* header is NULL for a legacy payload (single ASCII digit), payload then points to the raw data */
+typedef void (*radio_command_handler)(radio_source *source, const radio_frame_header *header,
+		const uint8_t *payload, uint8_t len);
+
+void radio_link_init(nrf24_inst *radio, radio_source *sources, uint8_t count);
+uint8_t radio_link_poll(radio_command_handler handler, uint32_t now_ms);
+void radio_link_ack(uint8_t received, uint8_t *data, uint8_t len);
+
+#endif /* INC_RADIO_LINK_H_ */
@@ -0,0 +1,78 @@
+/*
+ * radio_protocol.h
+ *
+ *  Binary command frames sent by the handheld controller over the NRF24 link.
+ *
+ *  Frame layout (little endian, at most 32 bytes):
+ *    radio_frame_header | payload (depends on type) | crc16 over header and payload
+ */
+
+#ifndef INC_RADIO_PROTOCOL_H_
+#define INC_RADIO_PROTOCOL_H_
+
+#include <stdint.h>
+
+#define RADIO_FRAME_MAGIC      0xA5  /* never a printable digit, so legacy ASCII commands stay distinguishable */
+#define RADIO_FRAME_VERSION    1
+#define RADIO_STALE_MS         200   /* frames delayed more than this are discarded */
+#define RADIO_RESYNC_MS        1000  /* after this much silence any sequence number is accepted again */
+#define RADIO_OFFSET_WINDOW_MS 5000  /* the lowest clock offset is tracked over the last one to two windows */
+
+typedef enum
+{
+	RADIO_FRAME_STOP = 0,   /* no payload */
+	RADIO_FRAME_TWIST,      /* radio_twist_payload */
+	RADIO_FRAME_WHEELS      /* radio_wheels_payload */
+} radio_frame_type;
+
+typedef struct __attribute__((packed))
+{
+	uint8_t magic;         /* RADIO_FRAME_MAGIC */
+	uint8_t version;       /* RADIO_FRAME_VERSION */
+	uint8_t type;          /* radio_frame_type */
+	uint16_t seq;          /* incremented by the sender for every new frame */
+	uint32_t timestamp_ms; /* sender clock when the frame was built */
+} radio_frame_header;
+
+/* Body motion in wheel speed units: right wheels = linear + angular, left wheels = linear - angular */
+typedef struct __attribute__((packed))
+{
+	int16_t linear;  /* 0.01 RPM */
+	int16_t angular; /* 0.01 RPM, positive turns left */
+} radio_twist_payload;
+
+typedef struct __attribute__((packed))
+{
+	int16_t wheel[4]; /* wheel a..d setpoints in 0.01 RPM */
+} radio_wheels_payload;
+
+typedef enum
+{
+	radio_ok = 0,
+	radio_bad_length,
+	radio_bad_magic,
+	radio_bad_version,
+	radio_bad_crc,
+	radio_duplicate,
+	radio_stale
+} radio_status;
+
+typedef struct
+{
+	uint8_t synced;          /* a frame has been accepted since the last resync */
+	uint16_t last_seq;       /* sequence number of the last accepted frame */
+	uint32_t last_rx_ms;     /* local time of the last accepted frame */
+	int32_t min_offset_ms;   /* smallest recent (local - sender) time, i.e. the lowest latency */
+	int32_t window_min_ms;   /* smallest offset of the current window */
+	int32_t previous_min_ms; /* smallest offset of the previous window */
+	uint32_t window_start_ms;
+	uint32_t accepted;       /* frame counters */
+	uint32_t rejected;
+} radio_decoder;
+
+uint16_t radio_crc16(const uint8_t *data, uint8_t len);
+void radio_decoder_reset(radio_decoder *dec);
+radio_status radio_decode(radio_decoder *dec, const uint8_t *buf, uint8_t len, uint32_t now_ms,
+		const radio_frame_header **header, const uint8_t **payload);
+
+#endif /* INC_RADIO_PROTOCOL_H_ */
@@ -0,0 +1,31 @@
+/*
+ * rover_clock.h
+ *
+ *  Time base of the rover. The local clock is the DWT cycle counter extended to 64 bits, with the
+ *  resolution of the core clock and no jump. It is disciplined to the clock of the micro-ROS agent by
+ *  feeding it the result of every session synchronisation: the offset is measured at each sync and
+ *  the drift between two syncs is estimated to extrapolate until the next one.
+ */
+
+#ifndef INC_ROVER_CLOCK_H_
+#define INC_ROVER_CLOCK_H_
+
+#include <stdint.h>
+
+#define ROVER_CLOCK_DRIFT_FILTER 4  /* the drift estimate moves by 1/4 of each new measure */
+
+typedef struct{
+	int64_t offset_ns;      /* agent time - local time at the last sync */
+	uint64_t sync_local_ns; /* local time of the last sync */
+	float drift;            /* estimated agent clock rate - local clock rate (ns per ns) */
+	uint32_t syncs;         /* number of syncs, 0 until the first one */
+}rover_clock_sync_state;
+
+void rover_clock_init(void);
+void rover_clock_update(void);
+uint64_t rover_clock_local_ns(void);
+void rover_clock_sync(int64_t agent_ns, uint64_t local_ns);
+int64_t rover_clock_to_agent_ns(uint64_t local_ns);
+void rover_clock_get_sync(rover_clock_sync_state *state);
+
+#endif /* INC_ROVER_CLOCK_H_ */
@@ -0,0 +1,65 @@
+/*
+ * tlog.h
+ *
+ *  Tokenized deferred logging. TLOG(fmt, ...) stores the format string in the non-loaded .tlog_fmt
+ *  section and only records its offset and the raw arguments into a RAM ring, which a low priority
+ *  task drains to the console later. tools/tlog_decode.py rebuilds the text from the ELF.
+ *
+ *  Record on the wire: TLOG_SYNC | id (uint16) | nargs (uint8) | nargs x uint32 argument, little endian.
+ *  Arguments are integers (%d %u %x %c) or floats (%f %e %g, sent as IEEE single precision bits).
+ *  Strings (%s) cannot be deferred.
+ */
+
+#ifndef INC_TLOG_H_
+#define INC_TLOG_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define TLOG_BUFFER_SIZE 1024 /* power of two */
+#define TLOG_MAX_ARGS    4
+#define TLOG_SYNC        0x1E /* ASCII record separator, never part of printf text on the same console */
+
+typedef struct{
+	uint32_t records;        /* records queued */
+	uint32_t dropped;        /* records discarded because the ring was full */
+}tlog_stats;
+
+static inline uint32_t tlog_u32(uint32_t value)
+{
+	return value;
+}
+
+static inline uint32_t tlog_f32(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static inline uint32_t tlog_f64(double value)
+{
+	return tlog_f32((float)value);
+}
+
+#define TLOG_ARG(x) _Generic((x), float: tlog_f32, double: tlog_f64, default: tlog_u32)(x)
+
+#define TLOG_MAP0()
+#define TLOG_MAP1(a)          TLOG_ARG(a)
+#define TLOG_MAP2(a, b)       TLOG_ARG(a), TLOG_ARG(b)
+#define TLOG_MAP3(a, b, c)    TLOG_ARG(a), TLOG_ARG(b), TLOG_ARG(c)
+#define TLOG_MAP4(a, b, c, d) TLOG_ARG(a), TLOG_ARG(b), TLOG_ARG(c), TLOG_ARG(d)
+#define TLOG_SELECT(_0, _1, _2, _3, _4, map, ...) map
+#define TLOG_MAP(...) TLOG_SELECT(_0, ##__VA_ARGS__, TLOG_MAP4, TLOG_MAP3, TLOG_MAP2, TLOG_MAP1, TLOG_MAP0)(__VA_ARGS__)
+
+#define TLOG(fmt, ...) do { \
+		static const char tlog_fmt[] __attribute__((section(".tlog_fmt"), used)) = fmt; \
+		const uint32_t tlog_args[] = {0, TLOG_MAP(__VA_ARGS__)}; \
+		tlog_record((uint16_t)(uintptr_t)tlog_fmt, sizeof(tlog_args) / sizeof(uint32_t) - 1, &tlog_args[1]); \
+	} while (0)
+
+void tlog_record(uint16_t id, uint8_t nargs, const uint32_t *args);
+uint16_t tlog_drain(uint8_t *out, uint16_t size);
+const tlog_stats *tlog_get_stats(void);
+
+#endif /* INC_TLOG_H_ */
@@ -0,0 +1,33 @@
+/*
+ * wheel_batch.h
+ *
+ *  Queue of wheel control steps waiting to be sent in batches. The control tasks push one record per
+ *  step, the telemetry pops them in groups and flushes when enough are waiting or the oldest gets too old.
+ */
+
+#ifndef INC_WHEEL_BATCH_H_
+#define INC_WHEEL_BATCH_H_
+
+#include <stdint.h>
+#include "wheel_state.h"
+
+#define WHEEL_BATCH_RING 64   /* records, power of two */
+
+typedef struct{
+	wheel_sample sample;
+	uint8_t wheel;            /* 0..3 (a..d) */
+}wheel_record;
+
+typedef struct{
+	wheel_record records[WHEEL_BATCH_RING];
+	volatile uint32_t head;   /* free running, written by the control tasks */
+	volatile uint32_t tail;   /* free running, written by the telemetry */
+	uint32_t dropped;         /* records lost because the ring was full */
+}wheel_batch;
+
+void wheel_batch_push(wheel_batch *batch, uint8_t wheel, const wheel_sample *sample);
+uint32_t wheel_batch_pending(const wheel_batch *batch);
+uint8_t wheel_batch_due(const wheel_batch *batch, uint32_t count, uint32_t deadline_ms, uint64_t now_ns);
+uint32_t wheel_batch_pop(wheel_batch *batch, wheel_record *out, uint32_t max);
+
+#endif /* INC_WHEEL_BATCH_H_ */
@@ -0,0 +1,31 @@
+/*
+ * wheel_command.h
+ *
+ *  Lock-free handoff of wheel setpoints from a producer task (micro-ROS executor) to the task applying
+ *  them. The producer never waits: it fills the free slot of a double buffer and publishes it with a
+ *  sequence number, the consumer copies the latest slot and retries if it was overwritten meanwhile.
+ */
+
+#ifndef INC_WHEEL_COMMAND_H_
+#define INC_WHEEL_COMMAND_H_
+
+#include <stdint.h>
+
+#define WHEEL_COUNT 4
+
+typedef struct{
+	float wheel[WHEEL_COUNT];  /* setpoints a..d in RPM */
+	uint32_t stamp_ms;         /* local time the command was received */
+	uint32_t seq;              /* incremented for every posted command, 0 = never posted */
+}wheel_setpoint;
+
+typedef struct{
+	wheel_setpoint slot[2];
+	volatile uint32_t seq;     /* last published command, it lives in slot[seq & 1] */
+}wheel_mailbox;
+
+void wheel_mailbox_post(wheel_mailbox *box, const float wheel[WHEEL_COUNT], uint32_t now_ms);
+void wheel_mailbox_take(wheel_mailbox *box, wheel_setpoint *out);
+uint8_t wheel_setpoint_fresh(const wheel_setpoint *setpoint, uint32_t now_ms, uint32_t timeout_ms);
+
+#endif /* INC_WHEEL_COMMAND_H_ */
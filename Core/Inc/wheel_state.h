@@ -0,0 +1,37 @@
+/*
+ * wheel_state.h
+ *
+ *  Latest state of the four wheel control loops, written by the control tasks and read as one
+ *  consistent snapshot by the telemetry. Readers never block the control loops: they retry when
+ *  a control task updated its wheel while they were copying.
+ */
+
+#ifndef INC_WHEEL_STATE_H_
+#define INC_WHEEL_STATE_H_
+
+#include <stdint.h>
+#include "wheel_command.h"
+
+#define WHEEL_SAT_PID      0x01  /* PID output clamped to pid_max */
+#define WHEEL_SAT_INTEGRAL 0x02  /* error integral clamped to integral_max */
+#define WHEEL_SAT_DUTY     0x04  /* duty at 100 % */
+
+typedef struct{
+	int32_t counts;       /* encoder counter */
+	float position;       /* integrated velocity (RPM.s) */
+	float velocity;       /* measured velocity (RPM) */
+	float setpoint;       /* target velocity (RPM) */
+	float duty;           /* duty applied to the driver (%) */
+	uint8_t flags;        /* WHEEL_SAT_* */
+	uint64_t stamp_ns;    /* rover_clock local time of the control step */
+}wheel_sample;
+
+typedef struct{
+	wheel_sample wheel[WHEEL_COUNT];
+	volatile uint32_t seq; /* odd while a wheel is being written */
+}wheel_state;
+
+void wheel_state_update(wheel_state *state, uint8_t index, const wheel_sample *sample);
+uint32_t wheel_state_snapshot(wheel_state *state, wheel_sample out[WHEEL_COUNT]);
+
+#endif /* INC_WHEEL_STATE_H_ */
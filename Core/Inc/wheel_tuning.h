@@ -0,0 +1,31 @@
+/*
+ * wheel_tuning.h
+ *
+ *  Run-time tuning of one wheel loop. The new settings are staged by the task serving the parameter
+ *  requests and picked up by the control task between two of its steps, never in the middle of one.
+ *  The feedforward gain of the velocity to duty table is a single setting, staged the same way and
+ *  picked up by the task of wheel a, the only one that goes through the table.
+ */
+
+#ifndef INC_WHEEL_TUNING_H_
+#define INC_WHEEL_TUNING_H_
+
+#include <stdint.h>
+#include "pid_control.h"
+
+typedef struct{
+	pid_config pid;
+	uint16_t period_ms;     /* control step period */
+}wheel_tuning_config;
+
+typedef struct{
+	wheel_tuning_config staged;
+	volatile uint8_t pending;  /* staged holds settings not applied yet */
+}wheel_tuning;
+
+void wheel_tuning_stage(wheel_tuning *tuning, const wheel_tuning_config *config);
+uint8_t wheel_tuning_apply(wheel_tuning *tuning, pid_instance *pid, uint16_t *period_ms);
+void wheel_tuning_stage_ff_gain(float gain);
+uint8_t wheel_tuning_apply_ff_gain(void);
+
+#endif /* INC_WHEEL_TUNING_H_ */
@@ -6,251 +6,354 @@
  */
 
 
-#include "stm32f4xx_hal.h"
 #include "NRF24L01.h"
-#include "main.h"
+#include <string.h>
+
+/* Shadow copy of the configuration registers, so that mode switches do not have to read the chip.
+ * STATUS, OBSERVE_TX, CD and FIFO_STATUS change on their own and are never cached.
+ */
+#define NRF24_CACHED_REGS  ((0x7FUL<<CONFIG) | (0x0FUL<<RX_ADDR_P2) | (0x3FUL<<RX_PW_P0) | (0x03UL<<DYNPD))
 
-extern SPI_HandleTypeDef hspi1;
-#define NRF24_SPI &hspi1
 
-#define NRF24_CE_PORT   CE_GPIO_Port
-#define NRF24_CE_PIN    CE_Pin
+/* full duplex transfer on the radio SPI bus, tx or rx may be NULL */
+static void nrf24_spi (nrf24_inst *nrf, const uint8_t *tx, uint8_t *rx, uint16_t size)
+{
+	nrf->ops->transfer(nrf->ops_ctx, tx, rx, size);
+}
 
-#define NRF24_CSN_PORT   CSN_GPIO_Port
-#define NRF24_CSN_PIN    CSN_Pin
+static void nrf24_delay (nrf24_inst *nrf, uint32_t ms)
+{
+	nrf->ops->delay_ms(nrf->ops_ctx, ms);
+}
 
 
-void CS_Select (void)
+static void CS_Select (nrf24_inst *nrf)
 {
-	HAL_GPIO_WritePin(NRF24_CSN_PORT, NRF24_CSN_PIN, GPIO_PIN_RESET);
+	nrf->ops->csn(nrf->ops_ctx, 0);
 }
 
-void CS_UnSelect (void)
+static void CS_UnSelect (nrf24_inst *nrf)
 {
-	HAL_GPIO_WritePin(NRF24_CSN_PORT, NRF24_CSN_PIN, GPIO_PIN_SET);
+	nrf->ops->csn(nrf->ops_ctx, 1);
 }
 
 
-void CE_Enable (void)
+static void CE_Enable (nrf24_inst *nrf)
 {
-	HAL_GPIO_WritePin(NRF24_CE_PORT, NRF24_CE_PIN, GPIO_PIN_SET);
+	nrf->ops->ce(nrf->ops_ctx, 1);
 }
 
-void CE_Disable (void)
+static void CE_Disable (nrf24_inst *nrf)
 {
-	HAL_GPIO_WritePin(NRF24_CE_PORT, NRF24_CE_PIN, GPIO_PIN_RESET);
+	nrf->ops->ce(nrf->ops_ctx, 0);
 }
 
 
 
+static uint8_t nrf24_isCached (uint8_t Reg)
+{
+	return (Reg < 32) && (NRF24_CACHED_REGS & (1UL<<Reg));
+}
+
+// index in shadow_addr of a 5 byte address register, -1 if it is not one
+static int nrf24_addrIndex (uint8_t Reg)
+{
+	if (Reg == RX_ADDR_P0) return 0;
+	if (Reg == RX_ADDR_P1) return 1;
+	if (Reg == TX_ADDR) return 2;
+	return -1;
+}
+
 // write a single byte to the particular register
-void nrf24_WriteReg (uint8_t Reg, uint8_t Data)
+static void nrf24_WriteReg (nrf24_inst *nrf, uint8_t Reg, uint8_t Data)
 {
+	if (nrf24_isCached(Reg))
+	{
+		// skip the SPI transaction if the chip already holds this value
+		if ((nrf->shadow_valid & (1UL<<Reg)) && (nrf->shadow_reg[Reg] == Data))
+		{
+			return;
+		}
+
+		nrf->shadow_reg[Reg] = Data;
+		nrf->shadow_valid |= (1UL<<Reg);
+	}
+
 	uint8_t buf[2];
 	buf[0] = Reg|1<<5;
 	buf[1] = Data;
 
 	// Pull the CS Pin LOW to select the device
-	CS_Select();
+	CS_Select(nrf);
 
-	HAL_SPI_Transmit(NRF24_SPI, buf, 2, 1000);
+	nrf24_spi(nrf, buf, NULL, 2);
 
 	// Pull the CS HIGH to release the device
-	CS_UnSelect();
+	CS_UnSelect(nrf);
 }
 
 //write multiple bytes starting from a particular register
-void nrf24_WriteRegMulti (uint8_t Reg, uint8_t *data, int size)
+static void nrf24_WriteRegMulti (nrf24_inst *nrf, uint8_t Reg, const uint8_t *data, int size)
 {
-	uint8_t buf[2];
+	int index = nrf24_addrIndex(Reg);
+
+	if ((index >= 0) && (size == 5))
+	{
+		// skip the SPI transaction if the chip already holds this address
+		if ((nrf->shadow_addr_valid & (1<<index)) && (memcmp(nrf->shadow_addr[index], data, 5) == 0))
+		{
+			return;
+		}
+
+		memcpy(nrf->shadow_addr[index], data, 5);
+		nrf->shadow_addr_valid |= (1<<index);
+	}
+
+	// command and data in a single SPI transfer, the multi byte registers are at most 5 bytes long
+	if (size > 5)
+	{
+		size = 5;
+	}
+
+	uint8_t buf[6];
 	buf[0] = Reg|1<<5;
-//	buf[1] = Data;
+	memcpy(&buf[1], data, size);
 
 	// Pull the CS Pin LOW to select the device
-	CS_Select();
+	CS_Select(nrf);
 
-	HAL_SPI_Transmit(NRF24_SPI, buf, 1, 100);
-	HAL_SPI_Transmit(NRF24_SPI, data, size, 1000);
+	nrf24_spi(nrf, buf, NULL, size + 1);
 
 	// Pull the CS HIGH to release the device
-	CS_UnSelect();
+	CS_UnSelect(nrf);
 }
 
 
-uint8_t nrf24_ReadReg (uint8_t Reg)
+static uint8_t nrf24_ReadReg (nrf24_inst *nrf, uint8_t Reg)
 {
-	uint8_t data=0;
+	uint8_t tx[2] = {Reg, NOP};
+	uint8_t rx[2] = {0, 0};
 
 	// Pull the CS Pin LOW to select the device
-	CS_Select();
+	CS_Select(nrf);
 
-	HAL_SPI_Transmit(NRF24_SPI, &Reg, 1, 100);
-	HAL_SPI_Receive(NRF24_SPI, &data, 1, 100);
+	nrf24_spi(nrf, tx, rx, 2);
 
 	// Pull the CS HIGH to release the device
-	CS_UnSelect();
+	CS_UnSelect(nrf);
+
+	return rx[1];
+}
+
+
+// value of a configuration register, from the shadow copy when it is known
+static uint8_t nrf24_ShadowReg (nrf24_inst *nrf, uint8_t Reg)
+{
+	if (nrf24_isCached(Reg) && (nrf->shadow_valid & (1UL<<Reg)))
+	{
+		return nrf->shadow_reg[Reg];
+	}
+
+	uint8_t data = nrf24_ReadReg(nrf, Reg);
+
+	if (nrf24_isCached(Reg))
+	{
+		nrf->shadow_reg[Reg] = data;
+		nrf->shadow_valid |= (1UL<<Reg);
+	}
 
 	return data;
 }
 
 
+// the chip shifts STATUS out while it receives any command, a NOP gets it in a single byte transfer
+static uint8_t nrf24_Status (nrf24_inst *nrf)
+{
+	uint8_t cmd = NOP;
+	uint8_t status = 0;
+
+	CS_Select(nrf);
+	nrf24_spi(nrf, &cmd, &status, 1);
+	CS_UnSelect(nrf);
+
+	return status;
+}
+
+
 /* Read multiple bytes from the register */
-void nrf24_ReadReg_Multi (uint8_t Reg, uint8_t *data, int size)
+static void nrf24_ReadReg_Multi (nrf24_inst *nrf, uint8_t Reg, uint8_t *data, int size)
 {
 	// Pull the CS Pin LOW to select the device
-	CS_Select();
+	CS_Select(nrf);
 
-	HAL_SPI_Transmit(NRF24_SPI, &Reg, 1, 100);
-	HAL_SPI_Receive(NRF24_SPI, data, size, 1000);
+	nrf24_spi(nrf, &Reg, NULL, 1);
+	nrf24_spi(nrf, NULL, data, size);
 
 	// Pull the CS HIGH to release the device
-	CS_UnSelect();
+	CS_UnSelect(nrf);
 }
 
 
 // send the command to the NRF
-void nrfsendCmd (uint8_t cmd)
+static void nrfsendCmd (nrf24_inst *nrf, uint8_t cmd)
 {
 	// Pull the CS Pin LOW to select the device
-	CS_Select();
+	CS_Select(nrf);
 
-	HAL_SPI_Transmit(NRF24_SPI, &cmd, 1, 100);
+	nrf24_spi(nrf, &cmd, NULL, 1);
 
 	// Pull the CS HIGH to release the device
-	CS_UnSelect();
+	CS_UnSelect(nrf);
 }
 
-void nrf24_reset(uint8_t REG)
+static void nrf24_reset(nrf24_inst *nrf, uint8_t REG)
 {
 	if (REG == STATUS)
 	{
-		nrf24_WriteReg(STATUS, 0x00);
+		nrf24_WriteReg(nrf, STATUS, 0x00);
 	}
 
 	else if (REG == FIFO_STATUS)
 	{
-		nrf24_WriteReg(FIFO_STATUS, 0x11);
+		nrf24_WriteReg(nrf, FIFO_STATUS, 0x11);
 	}
 
 	else {
-	nrf24_WriteReg(CONFIG, 0x08);
-	nrf24_WriteReg(EN_AA, 0x3F);
-	nrf24_WriteReg(EN_RXADDR, 0x03);
-	nrf24_WriteReg(SETUP_AW, 0x03);
-	nrf24_WriteReg(SETUP_RETR, 0x03);
-	nrf24_WriteReg(RF_CH, 0x02);
-	nrf24_WriteReg(RF_SETUP, 0x0E);
-	nrf24_WriteReg(STATUS, 0x00);
-	nrf24_WriteReg(OBSERVE_TX, 0x00);
-	nrf24_WriteReg(CD, 0x00);
+	nrf24_WriteReg(nrf, CONFIG, 0x08);
+	nrf24_WriteReg(nrf, EN_AA, 0x3F);
+	nrf24_WriteReg(nrf, EN_RXADDR, 0x03);
+	nrf24_WriteReg(nrf, SETUP_AW, 0x03);
+	nrf24_WriteReg(nrf, SETUP_RETR, 0x03);
+	nrf24_WriteReg(nrf, RF_CH, 0x02);
+	nrf24_WriteReg(nrf, RF_SETUP, 0x0E);
+	nrf24_WriteReg(nrf, STATUS, 0x00);
+	nrf24_WriteReg(nrf, OBSERVE_TX, 0x00);
+	nrf24_WriteReg(nrf, CD, 0x00);
 	uint8_t rx_addr_p0_def[5] = {0xE7, 0xE7, 0xE7, 0xE7, 0xE7};
-	nrf24_WriteRegMulti(RX_ADDR_P0, rx_addr_p0_def, 5);
+	nrf24_WriteRegMulti(nrf, RX_ADDR_P0, rx_addr_p0_def, 5);
 	uint8_t rx_addr_p1_def[5] = {0xC2, 0xC2, 0xC2, 0xC2, 0xC2};
-	nrf24_WriteRegMulti(RX_ADDR_P1, rx_addr_p1_def, 5);
-	nrf24_WriteReg(RX_ADDR_P2, 0xC3);
-	nrf24_WriteReg(RX_ADDR_P3, 0xC4);
-	nrf24_WriteReg(RX_ADDR_P4, 0xC5);
-	nrf24_WriteReg(RX_ADDR_P5, 0xC6);
+	nrf24_WriteRegMulti(nrf, RX_ADDR_P1, rx_addr_p1_def, 5);
+	nrf24_WriteReg(nrf, RX_ADDR_P2, 0xC3);
+	nrf24_WriteReg(nrf, RX_ADDR_P3, 0xC4);
+	nrf24_WriteReg(nrf, RX_ADDR_P4, 0xC5);
+	nrf24_WriteReg(nrf, RX_ADDR_P5, 0xC6);
 	uint8_t tx_addr_def[5] = {0xE7, 0xE7, 0xE7, 0xE7, 0xE7};
-	nrf24_WriteRegMulti(TX_ADDR, tx_addr_def, 5);
-	nrf24_WriteReg(RX_PW_P0, 0);
-	nrf24_WriteReg(RX_PW_P1, 0);
-	nrf24_WriteReg(RX_PW_P2, 0);
-	nrf24_WriteReg(RX_PW_P3, 0);
-	nrf24_WriteReg(RX_PW_P4, 0);
-	nrf24_WriteReg(RX_PW_P5, 0);
-	nrf24_WriteReg(FIFO_STATUS, 0x11);
-	nrf24_WriteReg(DYNPD, 0);
-	nrf24_WriteReg(FEATURE, 0);
+	nrf24_WriteRegMulti(nrf, TX_ADDR, tx_addr_def, 5);
+	nrf24_WriteReg(nrf, RX_PW_P0, 0);
+	nrf24_WriteReg(nrf, RX_PW_P1, 0);
+	nrf24_WriteReg(nrf, RX_PW_P2, 0);
+	nrf24_WriteReg(nrf, RX_PW_P3, 0);
+	nrf24_WriteReg(nrf, RX_PW_P4, 0);
+	nrf24_WriteReg(nrf, RX_PW_P5, 0);
+	nrf24_WriteReg(nrf, FIFO_STATUS, 0x11);
+	nrf24_WriteReg(nrf, DYNPD, 0);
+	nrf24_WriteReg(nrf, FEATURE, 0);
 	}
 }
 
 
 
 
-void NRF24_Init (void)
+void NRF24_Init (nrf24_inst *nrf)
 {
 	// disable the chip before configuring the device
-	CE_Disable();
+	CE_Disable(nrf);
+
+	// nothing is known about the chip state yet
+	nrf->shadow_valid = 0;
+	nrf->shadow_addr_valid = 0;
 
 
 	// reset everything
-	nrf24_reset (0);
+	nrf24_reset(nrf, 0);
 
-	nrf24_WriteReg(CONFIG, 0);  // will be configured later
+	nrf24_WriteReg(nrf, CONFIG, 0);  // will be configured later
 
-	nrf24_WriteReg(EN_AA, 0);  // No Auto ACK
+	nrf24_WriteReg(nrf, EN_AA, 0);  // No Auto ACK
 
-	nrf24_WriteReg (EN_RXADDR, 0);  // Not Enabling any data pipe right now
+	nrf24_WriteReg(nrf, EN_RXADDR, 0);  // Not Enabling any data pipe right now
 
-	nrf24_WriteReg (SETUP_AW, 0x03);  // 5 Bytes for the TX/RX address
+	nrf24_WriteReg(nrf, SETUP_AW, 0x03);  // 5 Bytes for the TX/RX address
 
-	nrf24_WriteReg (SETUP_RETR, 0);   // No retransmission
+	nrf24_WriteReg(nrf, SETUP_RETR, 0);   // No retransmission
 
-	nrf24_WriteReg (RF_CH, 0);  // will be setup during Tx or RX
+	nrf24_WriteReg(nrf, RF_CH, 0);  // will be setup during Tx or RX
 
-	nrf24_WriteReg (RF_SETUP, 0x0E);   // Power= 0db, data rate = 2Mbps
+	nrf24_WriteReg(nrf, RF_SETUP, 0x0E);   // Power= 0db, data rate = 2Mbps
+
+	nrf->mode = NRF24_MODE_POWER_DOWN;
 
 	// Enable the chip after configuring the device
-	CE_Enable();
+	CE_Enable(nrf);
 
 }
 
 
 // set up the Tx mode
 
-void NRF24_TxMode (uint8_t *Address, uint8_t channel)
+void NRF24_TxMode (nrf24_inst *nrf)
 {
 	// disable the chip before configuring the device
-	CE_Disable();
+	CE_Disable(nrf);
+
+	nrf24_WriteReg(nrf, RF_CH, nrf->channel);  // select the channel
 
-	nrf24_WriteReg (RF_CH, channel);  // select the channel
+	nrf24_WriteRegMulti(nrf, TX_ADDR, nrf->address, 5);  // Write the TX address
 
-	nrf24_WriteRegMulti(TX_ADDR, Address, 5);  // Write the TX address
+	/* With auto acknowledge the ACK (and any ACK payload) comes back on pipe 0,
+	 * so pipe 0 has to listen on the same address we are transmitting to.
+	 * ACK payloads also need dynamic payload length on pipe 0, see NRF24_EnableDynamicPayload
+	 */
+	nrf24_WriteRegMulti(nrf, RX_ADDR_P0, nrf->address, 5);
 
+	uint8_t en_rxaddr = nrf24_ShadowReg(nrf, EN_RXADDR);
+	nrf24_WriteReg(nrf, EN_RXADDR, en_rxaddr | (1<<0));
+
+	uint8_t en_aa = nrf24_ShadowReg(nrf, EN_AA);
+	nrf24_WriteReg(nrf, EN_AA, en_aa | (1<<0));
 
 	// power up the device
-	uint8_t config = nrf24_ReadReg(CONFIG);
-//	config = config | (1<<1);   // write 1 in the PWR_UP bit
-	config = config & (0xF2);    // write 0 in the PRIM_RX, and 1 in the PWR_UP, and all other bits are masked
-	nrf24_WriteReg (CONFIG, config);
+	uint8_t config = nrf24_ShadowReg(nrf, CONFIG);
+	config = (config & (0xF2)) | (1<<1);    // write 0 in the PRIM_RX, and 1 in the PWR_UP, and all other bits are masked
+	nrf24_WriteReg(nrf, CONFIG, config);
+	nrf->mode = NRF24_MODE_TX;
 
 	// Enable the chip after configuring the device
-	CE_Enable();
+	CE_Enable(nrf);
 }
 
 
 // transmit the data
 
-uint8_t NRF24_Transmit (uint8_t *data)
+uint8_t NRF24_Transmit (nrf24_inst *nrf, uint8_t *data)
 {
 	uint8_t cmdtosend = 0;
 
 	// select the device
-	CS_Select();
+	CS_Select(nrf);
 
 	// payload command
 	cmdtosend = W_TX_PAYLOAD;
-	HAL_SPI_Transmit(NRF24_SPI, &cmdtosend, 1, 100);
+	nrf24_spi(nrf, &cmdtosend, NULL, 1);
 
 	// send the payload
-	HAL_SPI_Transmit(NRF24_SPI, data, 32, 1000);
+	nrf24_spi(nrf, data, NULL, 32);
 
 	// Unselect the device
-	CS_UnSelect();
+	CS_UnSelect(nrf);
 
-	HAL_Delay(1);
+	nrf24_delay(nrf, 1);
 
-	uint8_t fifostatus = nrf24_ReadReg(FIFO_STATUS);
+	uint8_t fifostatus = nrf24_ReadReg(nrf, FIFO_STATUS);
 
 	// check the fourth bit of FIFO_STATUS to know if the TX fifo is empty
 	if ((fifostatus&(1<<4)) && (!(fifostatus&(1<<3))))
 	{
 		cmdtosend = FLUSH_TX;
-		nrfsendCmd(cmdtosend);
+		nrfsendCmd(nrf, cmdtosend);
 
 		// reset FIFO_STATUS
-		nrf24_reset (FIFO_STATUS);
+		nrf24_reset(nrf, FIFO_STATUS);
 
 		return 1;
 	}
@@ -259,19 +362,14 @@ uint8_t NRF24_Transmit (uint8_t *data)
 }
 
 
-void NRF24_RxMode (uint8_t *Address, uint8_t channel)
+void NRF24_RxMode (nrf24_inst *nrf)
 {
 	// disable the chip before configuring the device
-	CE_Disable();
-
-	nrf24_reset (STATUS);
+	CE_Disable(nrf);
 
-	nrf24_WriteReg (RF_CH, channel);  // select the channel
+	nrf24_reset(nrf, STATUS);
 
-	// select data pipe 1
-	uint8_t en_rxaddr = nrf24_ReadReg(EN_RXADDR);
-	en_rxaddr = en_rxaddr | (1<<2);
-	nrf24_WriteReg (EN_RXADDR, en_rxaddr);
+	nrf24_WriteReg(nrf, RF_CH, nrf->channel);  // select the channel
 
 	/* We must write the address for Data Pipe 1, if we want to use any pipe from 2 to 5
 	 * The Address from DATA Pipe 2 to Data Pipe 5 differs only in the LSB
@@ -282,31 +380,155 @@ void NRF24_RxMode (uint8_t *Address, uint8_t channel)
 	 * Pipe 2 ADDR = 0xAABBCCDD22
 	 * Pipe 3 ADDR = 0xAABBCCDD33
 	 *
+	 * The pipes themselves are enabled with NRF24_OpenRxPipe
 	 */
-	nrf24_WriteRegMulti(RX_ADDR_P1, Address, 5);  // Write the Pipe1 address
-	nrf24_WriteReg(RX_ADDR_P2, 0xEE);  // Write the Pipe2 LSB address
-
-	nrf24_WriteReg (RX_PW_P2, 32);   // 32 bit payload size for pipe 2
+	nrf24_WriteRegMulti(nrf, RX_ADDR_P1, nrf->address, 5);  // Write the Pipe1 address
 
 
 	// power up the device in Rx mode
-	uint8_t config = nrf24_ReadReg(CONFIG);
+	uint8_t config = nrf24_ShadowReg(nrf, CONFIG);
 	config = config | (1<<1) | (1<<0);
-	nrf24_WriteReg (CONFIG, config);
+	nrf24_WriteReg(nrf, CONFIG, config);
+	nrf->mode = NRF24_MODE_RX;
+
+	// Enable the chip after configuring the device
+	CE_Enable(nrf);
+}
+
+
+// enable the FEATURE register, the original nRF24L01 needs the ACTIVATE command for it
+static void nrf24_activateFeatures (nrf24_inst *nrf, uint8_t feature)
+{
+	if ((nrf->shadow_valid & (1UL<<FEATURE)) && (nrf->shadow_reg[FEATURE] == feature))
+	{
+		return;
+	}
+
+	nrf24_WriteReg(nrf, FEATURE, feature);
+
+	if (nrf24_ReadReg(nrf, FEATURE) != feature)
+	{
+		uint8_t buf[2];
+		buf[0] = ACTIVATE;
+		buf[1] = 0x73;
+
+		CS_Select(nrf);
+		nrf24_spi(nrf, buf, NULL, 2);
+		CS_UnSelect(nrf);
+
+		nrf->shadow_valid &= ~(1UL<<FEATURE);
+		nrf24_WriteReg(nrf, FEATURE, feature);
+	}
+}
+
+
+/* enable dynamic payload length on the pipes set in pipemask (bit n = pipe n)
+ * Dynamic payload length needs auto acknowledge, so it is enabled on the same pipes
+ */
+void NRF24_EnableDynamicPayload (nrf24_inst *nrf, uint8_t pipemask)
+{
+	// disable the chip before configuring the device
+	CE_Disable(nrf);
+
+	nrf24_activateFeatures(nrf, nrf24_ShadowReg(nrf, FEATURE) | (1<<2));  // EN_DPL
+
+	uint8_t en_aa = nrf24_ShadowReg(nrf, EN_AA);
+	nrf24_WriteReg(nrf, EN_AA, en_aa | pipemask);
+
+	uint8_t dynpd = nrf24_ShadowReg(nrf, DYNPD);
+	nrf24_WriteReg(nrf, DYNPD, dynpd | pipemask);
 
 	// Enable the chip after configuring the device
-	CE_Enable();
+	CE_Enable(nrf);
 }
 
 
-uint8_t isDataAvailable (int pipenum)
+// allow payloads to be attached to the auto acknowledge packets
+void NRF24_EnableAckPayload (nrf24_inst *nrf)
 {
-	uint8_t status = nrf24_ReadReg(STATUS);
+	// disable the chip before configuring the device
+	CE_Disable(nrf);
+
+	nrf24_activateFeatures(nrf, nrf24_ShadowReg(nrf, FEATURE) | (1<<2) | (1<<1));  // EN_DPL, EN_ACK_PAY
+
+	// Enable the chip after configuring the device
+	CE_Enable(nrf);
+}
 
-	if ((status&(1<<6))&&(status&(pipenum<<1)))
+
+/* Enable a receive pipe
+ * Address: 5 bytes for pipes 0 and 1, only Address[0] (the LSB) is used for pipes 2 to 5
+ * width: fixed payload width in bytes, the pipe then runs without auto acknowledge like the
+ *        transmitters sending static payloads, or 0 for dynamic payload length with auto acknowledge
+ */
+void NRF24_OpenRxPipe (nrf24_inst *nrf, int pipenum, const uint8_t *Address, uint8_t width)
+{
+	if ((pipenum < 0) || (pipenum > 5) || (width > 32))
 	{
+		return;
+	}
+
+	// disable the chip before configuring the device
+	CE_Disable(nrf);
+
+	if (pipenum < 2)
+	{
+		nrf24_WriteRegMulti(nrf, RX_ADDR_P0 + pipenum, Address, 5);
+	}
+	else
+	{
+		nrf24_WriteReg(nrf, RX_ADDR_P0 + pipenum, Address[0]);
+	}
+
+	uint8_t dynpd = nrf24_ShadowReg(nrf, DYNPD);
+	if (width == 0)
+	{
+		nrf24_activateFeatures(nrf, nrf24_ShadowReg(nrf, FEATURE) | (1<<2));  // EN_DPL
+
+		uint8_t en_aa = nrf24_ShadowReg(nrf, EN_AA);
+		nrf24_WriteReg(nrf, EN_AA, en_aa | (1<<pipenum));  // dynamic payload length needs auto acknowledge
+		nrf24_WriteReg(nrf, DYNPD, dynpd | (1<<pipenum));
+	}
+	else
+	{
+		uint8_t en_aa = nrf24_ShadowReg(nrf, EN_AA);
+		nrf24_WriteReg(nrf, EN_AA, en_aa & ~(1<<pipenum));
+		nrf24_WriteReg(nrf, DYNPD, dynpd & ~(1<<pipenum));
+		nrf24_WriteReg(nrf, RX_PW_P0 + pipenum, width);
+	}
 
-		nrf24_WriteReg(STATUS, (1<<6));
+	uint8_t en_rxaddr = nrf24_ShadowReg(nrf, EN_RXADDR);
+	nrf24_WriteReg(nrf, EN_RXADDR, en_rxaddr | (1<<pipenum));
+
+	// Enable the chip after configuring the device
+	CE_Enable(nrf);
+}
+
+
+/* Pipe number of the payload at the head of the RX FIFO (RX_P_NO in STATUS)
+ * returns 7 when the RX FIFO is empty. The RX_DR flag is cleared on the way.
+ */
+uint8_t NRF24_RxPipe (nrf24_inst *nrf)
+{
+	uint8_t status = nrf24_Status(nrf);
+
+	if (status&(1<<6))
+	{
+		nrf24_WriteReg(nrf, STATUS, (1<<6));
+	}
+
+	return (status>>1) & 0x07;
+}
+
+
+uint8_t isDataAvailable (nrf24_inst *nrf, int pipenum)
+{
+	uint8_t status = nrf24_Status(nrf);
+
+	if ((status&(1<<6))&&(((status>>1) & 0x07) == pipenum))
+	{
+
+		nrf24_WriteReg(nrf, STATUS, (1<<6));
 
 		return 1;
 	}
@@ -315,53 +537,206 @@ uint8_t isDataAvailable (int pipenum)
 }
 
 
-void NRF24_Receive (uint8_t *data)
+void NRF24_Receive (nrf24_inst *nrf, uint8_t *data)
 {
 	uint8_t cmdtosend = 0;
 
 	// select the device
-	CS_Select();
+	CS_Select(nrf);
 
 	// payload command
 	cmdtosend = R_RX_PAYLOAD;
-	HAL_SPI_Transmit(NRF24_SPI, &cmdtosend, 1, 100);
+	nrf24_spi(nrf, &cmdtosend, NULL, 1);
 
 	// Receive the payload
-	HAL_SPI_Receive(NRF24_SPI, data, 32, 1000);
+	nrf24_spi(nrf, NULL, data, 32);
 
 	// Unselect the device
-	CS_UnSelect();
+	CS_UnSelect(nrf);
 
-	HAL_Delay(1);
+	nrf24_delay(nrf, 1);
 
 	cmdtosend = FLUSH_RX;
-	nrfsendCmd(cmdtosend);
+	nrfsendCmd(nrf, cmdtosend);
 }
 
 
 
 // Read all the Register data
-void NRF24_ReadAll (uint8_t *data)
+void NRF24_ReadAll (nrf24_inst *nrf, uint8_t *data)
 {
 	for (int i=0; i<10; i++)
 	{
-		*(data+i) = nrf24_ReadReg(i);
+		*(data+i) = nrf24_ReadReg(nrf, i);
 	}
 
-	nrf24_ReadReg_Multi(RX_ADDR_P0, (data+10), 5);
+	nrf24_ReadReg_Multi(nrf, RX_ADDR_P0, (data+10), 5);
 
-	nrf24_ReadReg_Multi(RX_ADDR_P1, (data+15), 5);
+	nrf24_ReadReg_Multi(nrf, RX_ADDR_P1, (data+15), 5);
 
-	*(data+20) = nrf24_ReadReg(RX_ADDR_P2);
-	*(data+21) = nrf24_ReadReg(RX_ADDR_P3);
-	*(data+22) = nrf24_ReadReg(RX_ADDR_P4);
-	*(data+23) = nrf24_ReadReg(RX_ADDR_P5);
+	*(data+20) = nrf24_ReadReg(nrf, RX_ADDR_P2);
+	*(data+21) = nrf24_ReadReg(nrf, RX_ADDR_P3);
+	*(data+22) = nrf24_ReadReg(nrf, RX_ADDR_P4);
+	*(data+23) = nrf24_ReadReg(nrf, RX_ADDR_P5);
 
-	nrf24_ReadReg_Multi(RX_ADDR_P0, (data+24), 5);
+	nrf24_ReadReg_Multi(nrf, RX_ADDR_P0, (data+24), 5);
 
 	for (int i=29; i<38; i++)
 	{
-		*(data+i) = nrf24_ReadReg(i-12);
+		*(data+i) = nrf24_ReadReg(nrf, i-12);
+	}
+
+}
+
+
+
+// check the RX_EMPTY bit of FIFO_STATUS
+uint8_t NRF24_RxFifoEmpty (nrf24_inst *nrf)
+{
+	return (nrf24_ReadReg(nrf, FIFO_STATUS) & (1<<0)) ? 1 : 0;
+}
+
+
+/* Receive one payload of dynamic length
+ * returns the number of bytes written to data, or 0 if the packet was corrupted
+ */
+uint8_t NRF24_ReceiveDynamic (nrf24_inst *nrf, uint8_t *data)
+{
+	uint8_t cmdtosend = 0;
+
+	uint8_t width = nrf24_ReadReg(nrf, R_RX_PL_WID);
+
+	// a width above 32 bytes means the packet is corrupted and has to be flushed
+	if ((width == 0) || (width > 32))
+	{
+		cmdtosend = FLUSH_RX;
+		nrfsendCmd(nrf, cmdtosend);
+
+		return 0;
+	}
+
+	return NRF24_ReceiveWidth(nrf, data, width);
+}
+
+
+/* Receive one payload of a known width (pipes with a fixed RX_PW_Px)
+ * Unlike NRF24_Receive the rest of the RX FIFO is kept
+ */
+uint8_t NRF24_ReceiveWidth (nrf24_inst *nrf, uint8_t *data, uint8_t width)
+{
+	uint8_t cmdtosend = 0;
+
+	// select the device
+	CS_Select(nrf);
+
+	// payload command
+	cmdtosend = R_RX_PAYLOAD;
+	nrf24_spi(nrf, &cmdtosend, NULL, 1);
+
+	// Receive the payload
+	nrf24_spi(nrf, NULL, data, width);
+
+	// Unselect the device
+	CS_UnSelect(nrf);
+
+	return width;
+}
+
+
+/* Load a payload to be sent with the next ACK on the pipe
+ * Any payload still waiting in the TX FIFO is flushed first, so the ACK always carries the latest data
+ */
+uint8_t NRF24_WriteAckPayload (nrf24_inst *nrf, int pipenum, const uint8_t *data, uint8_t size)
+{
+	uint8_t cmdtosend = 0;
+
+	if ((size == 0) || (size > 32))
+	{
+		return 0;
+	}
+
+	// check the fourth bit of FIFO_STATUS to know if the TX fifo is empty
+	uint8_t fifostatus = nrf24_ReadReg(nrf, FIFO_STATUS);
+	if (!(fifostatus&(1<<4)))
+	{
+		cmdtosend = FLUSH_TX;
+		nrfsendCmd(nrf, cmdtosend);
+	}
+
+	// select the device
+	CS_Select(nrf);
+
+	// payload command, the pipe number goes in the 3 LSB
+	cmdtosend = W_ACK_PAYLOAD | (pipenum & 0x07);
+	nrf24_spi(nrf, &cmdtosend, NULL, 1);
+
+	// send the payload
+	nrf24_spi(nrf, data, NULL, size);
+
+	// Unselect the device
+	CS_UnSelect(nrf);
+
+	return 1;
+}
+
+
+/* Compare the shadow copy with the chip registers
+ * repair: when set, the registers that differ are rewritten from the shadow copy
+ * returns the number of registers that did not match
+ */
+uint8_t NRF24_Verify (nrf24_inst *nrf, uint8_t repair)
+{
+	uint8_t mismatches = 0;
+	uint8_t addr[5];
+
+	if (repair)
+	{
+		CE_Disable(nrf);
+	}
+
+	for (uint8_t reg = 0; reg < 32; reg++)
+	{
+		if (!(nrf->shadow_valid & (1UL<<reg)) || (nrf24_ReadReg(nrf, reg) == nrf->shadow_reg[reg]))
+		{
+			continue;
+		}
+
+		mismatches++;
+
+		if (repair)
+		{
+			nrf->shadow_valid &= ~(1UL<<reg);
+			nrf24_WriteReg(nrf, reg, nrf->shadow_reg[reg]);
+		}
+	}
+
+	const uint8_t addr_regs[3] = {RX_ADDR_P0, RX_ADDR_P1, TX_ADDR};
+	for (int i = 0; i < 3; i++)
+	{
+		if (!(nrf->shadow_addr_valid & (1<<i)))
+		{
+			continue;
+		}
+
+		nrf24_ReadReg_Multi(nrf, addr_regs[i], addr, 5);
+		if (memcmp(addr, nrf->shadow_addr[i], 5) == 0)
+		{
+			continue;
+		}
+
+		mismatches++;
+
+		if (repair)
+		{
+			nrf->shadow_addr_valid &= ~(1<<i);
+			nrf24_WriteRegMulti(nrf, addr_regs[i], nrf->shadow_addr[i], 5);
+		}
+	}
+
+	if (repair)
+	{
+		CE_Enable(nrf);
 	}
 
+	return mismatches;
 }
@@ -0,0 +1,154 @@
+/*
+ * byte_ring.c
+ *
+ *  Copies in and out of the ring are at most two memcpy, one on each side of the wrap. Short reads
+ *  that end before the wrap, the usual case for the XRCE framing reads, copy byte by byte instead:
+ *  for a few bytes the memcpy calls cost more than the copy itself.
+ */
+
+#include "byte_ring.h"
+#include <string.h>
+
+#define BYTE_RING_SHORT_READ 16
+
+/*	@brief attach a ring to its storage and empty it
+ * 	@param ring: ring instance
+ * 	@param buffer: storage
+ * 	@param size: storage size, power of two
+ * 	@retval: none
+ * */
+void byte_ring_init(byte_ring *ring, uint8_t *buffer, uint32_t size)
+{
+	ring->buffer = buffer;
+	ring->size = size;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dma_pos = 0;
+}
+
+/*	@brief bytes waiting to be read, more than the size when a DMA writer lapped the reader
+ * 	@param ring: ring instance
+ * 	@retval: number of bytes
+ * */
+uint32_t byte_ring_used(const byte_ring *ring)
+{
+	return ring->head - ring->tail;
+}
+
+/*	@brief room left for the writer
+ * 	@param ring: ring instance
+ * 	@retval: number of bytes
+ * */
+uint32_t byte_ring_free(const byte_ring *ring)
+{
+	uint32_t used = byte_ring_used(ring);
+
+	return (used < ring->size) ? ring->size - used : 0;
+}
+
+/*	@brief copy data in, as much as fits
+ * 	@param ring: ring instance
+ * 	@param data: bytes to add
+ * 	@param len: number of bytes
+ * 	@retval: number of bytes copied
+ * */
+uint32_t byte_ring_write(byte_ring *ring, const uint8_t *data, uint32_t len)
+{
+	uint32_t space = byte_ring_free(ring);
+	uint32_t offset = ring->head & (ring->size - 1);
+
+	if (len > space)
+	{
+		len = space;
+	}
+
+	uint32_t first = ring->size - offset;
+	if (first > len)
+	{
+		first = len;
+	}
+	memcpy(&ring->buffer[offset], data, first);
+	memcpy(ring->buffer, data + first, len - first);
+
+	ring->head += len;
+	return len;
+}
+
+/*	@brief copy data out, as much as available
+ * 	@param ring: ring instance
+ * 	@param data: destination
+ * 	@param len: room in data
+ * 	@retval: number of bytes copied
+ * */
+uint32_t byte_ring_read(byte_ring *ring, uint8_t *data, uint32_t len)
+{
+	uint32_t tail = ring->tail;
+	uint32_t used = ring->head - tail;
+	uint32_t offset = tail & (ring->size - 1);
+
+	if (len > used)
+	{
+		len = used;
+	}
+
+	if ((len <= BYTE_RING_SHORT_READ) && (len <= ring->size - offset))
+	{
+		const uint8_t *src = &ring->buffer[offset];
+
+		for (uint32_t i = 0; i < len; i++)
+		{
+			data[i] = src[i];
+		}
+		ring->tail = tail + len;
+		return len;
+	}
+
+	uint32_t first = ring->size - offset;
+	if (first > len)
+	{
+		first = len;
+	}
+	memcpy(data, &ring->buffer[offset], first);
+	memcpy(data + first, ring->buffer, len - first);
+
+	ring->tail = tail + len;
+	return len;
+}
+
+/*	@brief contiguous block at the read side, e.g. for a DMA transfer
+ * 	@param ring: ring instance
+ * 	@param data: set to the start of the block
+ * 	@retval: block length, release it with byte_ring_skip
+ * */
+uint32_t byte_ring_linear(const byte_ring *ring, uint8_t **data)
+{
+	uint32_t used = byte_ring_used(ring);
+	uint32_t offset = ring->tail & (ring->size - 1);
+
+	*data = &ring->buffer[offset];
+	return (used < ring->size - offset) ? used : ring->size - offset;
+}
+
+/*	@brief drop bytes at the read side
+ * 	@param ring: ring instance
+ * 	@param len: number of bytes, at most byte_ring_used
+ * 	@retval: none
+ * */
+void byte_ring_skip(byte_ring *ring, uint32_t len)
+{
+	ring->tail += len;
+}
+
+/*	@brief advance head to the position of a circular DMA writing into the ring
+ * 	Must be called at least twice per lap (half and full transfer events) so that no lap is missed.
+ * 	@param ring: ring instance
+ * 	@param pos: DMA position in the buffer, i.e. size - NDTR
+ * 	@retval: new head
+ * */
+uint32_t byte_ring_dma_update(byte_ring *ring, uint32_t pos)
+{
+	pos &= ring->size - 1;
+	ring->head += (pos - ring->dma_pos) & (ring->size - 1);
+	ring->dma_pos = pos;
+	return ring->head;
+}
@@ -0,0 +1,115 @@
+/*
+ * command_mux.c
+ *
+ *  Submissions go through the lock-free wheel mailboxes, so the producers run in any task and never
+ *  wait. The tick runs in a single task.
+ */
+
+#include "command_mux.h"
+#include "kinematics.h"
+#include <string.h>
+
+/*	@brief attach the mux to its source table, no source active
+ * 	@param mux: mux instance
+ * 	@param sources: source table, kept by the mux
+ * 	@param count: number of sources
+ * 	@retval: none
+ * */
+void command_mux_init(command_mux *mux, command_source *sources, uint8_t count)
+{
+	memset(mux, 0, sizeof(command_mux));
+	mux->sources = sources;
+	mux->count = count;
+	mux->active = COMMAND_MUX_NONE;
+	mux->previous = COMMAND_MUX_NONE;
+}
+
+/*	@brief submit setpoints for a source, never blocks
+ * 	@param source: source, one producer per source
+ * 	@param wheel: setpoints a..d (RPM), all zero to stop
+ * 	@param now_ms: local time
+ * 	@retval: none
+ * */
+void command_mux_submit(command_source *source, const float wheel[WHEEL_COUNT], uint32_t now_ms)
+{
+	wheel_mailbox_post(&source->box, wheel, now_ms);
+}
+
+static uint8_t is_fresh(const command_source *source, uint32_t now_ms)
+{
+	return wheel_setpoint_fresh(&source->last, now_ms, source->lease_ms);
+}
+
+/*	@brief select the active source and update the output, once per control tick
+ * 	@param mux: mux instance
+ * 	@param now_ms: local time
+ * 	@retval: COMMAND_MUX_* bits, output holds the setpoints to apply when COMMAND_MUX_CHANGED is set
+ * */
+uint8_t command_mux_tick(command_mux *mux, uint32_t now_ms)
+{
+	int8_t selected = COMMAND_MUX_NONE;
+	uint8_t result = 0;
+	uint32_t elapsed = now_ms - mux->last_tick_ms;
+
+	mux->last_tick_ms = now_ms;
+
+	for (uint8_t i = 0; i < mux->count; i++)
+	{
+		command_source *source = &mux->sources[i];
+
+		wheel_mailbox_take(&source->box, &source->last);
+		if ((is_fresh(source, now_ms) || source->ramping) &&
+				((selected == COMMAND_MUX_NONE) || (source->priority > mux->sources[selected].priority)))
+		{
+			selected = i;
+		}
+	}
+
+	if (selected != mux->active)
+	{
+		if (mux->active != COMMAND_MUX_NONE)
+		{
+			// a preempted source loses the rest of its ramp
+			mux->sources[mux->active].ramping = 0;
+		}
+		if (selected != COMMAND_MUX_NONE)
+		{
+			mux->sources[selected].activations++;
+		}
+
+		mux->previous = mux->active;
+		mux->active = selected;
+		mux->applied_seq = 0;
+		mux->transitions++;
+		result |= COMMAND_MUX_TRANSITION | COMMAND_MUX_CHANGED;
+		memset(mux->output, 0, sizeof(mux->output));
+	}
+
+	if (selected == COMMAND_MUX_NONE)
+	{
+		return result;
+	}
+
+	command_source *source = &mux->sources[selected];
+
+	if (is_fresh(source, now_ms))
+	{
+		if (source->last.seq != mux->applied_seq)
+		{
+			mux->applied_seq = source->last.seq;
+			memcpy(mux->output, source->last.wheel, sizeof(mux->output));
+			memcpy(source->ramp, source->last.wheel, sizeof(source->ramp));
+			source->ramping = (source->ramp_rpm_per_s > 0);
+			result |= COMMAND_MUX_CHANGED;
+		}
+	}
+	else if (elapsed != 0)
+	{
+		// lease over, ramp down then release the source at the next tick
+		source->ramping = !ramp_to_zero(source->ramp, source->ramp_rpm_per_s * elapsed / 1000.0f);
+		memcpy(mux->output, source->ramp, sizeof(mux->output));
+		result |= COMMAND_MUX_CHANGED;
+	}
+
+	return result;
+}
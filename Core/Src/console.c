@@ -0,0 +1,105 @@
+/*
+ * console.c
+ *
+ *  Ring buffer drained by UART DMA. Writers copy their data in and return, the TX complete
+ *  interrupt chains the next contiguous chunk. When the ring is full the write is dropped and counted.
+ */
+
+#include "console.h"
+#include "critical.h"
+#include <string.h>
+
+/* start the DMA on the next contiguous part of the ring, with interrupts masked or from the TX complete interrupt */
+static void console_kick(console_inst *console)
+{
+	uint32_t pending = console->head - console->tail;
+	uint32_t offset = console->tail & (CONSOLE_BUFFER_SIZE - 1);
+
+	if ((console->in_flight != 0) || (pending == 0))
+	{
+		return;
+	}
+
+	if (pending > CONSOLE_BUFFER_SIZE - offset)
+	{
+		pending = CONSOLE_BUFFER_SIZE - offset;
+	}
+
+	if (HAL_UART_Transmit_DMA(console->huart, &console->buffer[offset], pending) == HAL_OK)
+	{
+		console->in_flight = pending;
+	}
+}
+
+/*	@brief attach the console to its uart
+ * 	@param console: console instance
+ * 	@param huart: uart used for the output
+ * 	@retval: none
+ * */
+void console_init(console_inst *console, UART_HandleTypeDef *huart)
+{
+	console->head = 0;
+	console->tail = 0;
+	console->in_flight = 0;
+	memset(&console->stats, 0, sizeof(console->stats));
+	console->huart = huart;
+}
+
+/*	@brief queue data for transmission, never blocks
+ * 	Safe from any task; the copy is a critical section so writes from several tasks do not interleave.
+ * 	@param console: console instance
+ * 	@param data: bytes to send
+ * 	@param len: number of bytes
+ * 	@retval: len when queued, 0 when dropped
+ * */
+uint16_t console_write(console_inst *console, const uint8_t *data, uint16_t len)
+{
+	uint32_t primask = critical_enter();
+
+	uint32_t space = CONSOLE_BUFFER_SIZE - (console->head - console->tail);
+
+	if ((console->huart == NULL) || (len > space))
+	{
+		console->stats.dropped_bytes += len;
+		console->stats.dropped_writes++;
+		critical_exit(primask);
+		return 0;
+	}
+
+	uint32_t offset = console->head & (CONSOLE_BUFFER_SIZE - 1);
+	uint32_t first = CONSOLE_BUFFER_SIZE - offset;
+
+	if (first > len)
+	{
+		first = len;
+	}
+	memcpy(&console->buffer[offset], data, first);
+	memcpy(console->buffer, data + first, len - first);
+
+	console->head += len;
+	console->stats.bytes += len;
+	console_kick(console);
+
+	critical_exit(primask);
+	return len;
+}
+
+/*	@brief room left in the ring
+ * 	@param console: console instance
+ * 	@retval: number of bytes a write can queue right now
+ * */
+uint16_t console_free(console_inst *console)
+{
+	return CONSOLE_BUFFER_SIZE - (console->head - console->tail);
+}
+
+/*	@brief release the chunk just sent and start the next one, call from HAL_UART_TxCpltCallback
+ * 	@param console: console instance
+ * 	@retval: none
+ * */
+void console_tx_complete(console_inst *console)
+{
+	console->tail += console->in_flight;
+	console->in_flight = 0;
+	console_kick(console);
+}
@@ -0,0 +1,55 @@
+/*
+ * kinematics.c
+ *
+ *  A twist the wheels cannot follow is scaled down as a whole, keeping the curvature of the path.
+ */
+
+#include "kinematics.h"
+#include <math.h>
+
+/*	@brief wheel setpoints of a body twist
+ * 	@param linear_mps: forward speed (m/s)
+ * 	@param angular_rps: yaw rate, counter-clockwise (rad/s)
+ * 	@param wheel_rpm: setpoints of wheels a..d (RPM)
+ * 	@retval: none
+ * */
+void twist_to_wheels(float linear_mps, float angular_rps, float wheel_rpm[WHEEL_COUNT])
+{
+	float right = (linear_mps + angular_rps * TRACK_WIDTH_M / 2) * 60.0f / WHEEL_CIRCUMFERENCE_M;
+	float left = (linear_mps - angular_rps * TRACK_WIDTH_M / 2) * 60.0f / WHEEL_CIRCUMFERENCE_M;
+	float largest = (fabsf(right) > fabsf(left)) ? fabsf(right) : fabsf(left);
+
+	if (largest > WHEEL_MAX_RPM)
+	{
+		right *= WHEEL_MAX_RPM / largest;
+		left *= WHEEL_MAX_RPM / largest;
+	}
+
+	wheel_rpm[0] = wheel_rpm[2] = right;
+	wheel_rpm[1] = wheel_rpm[3] = left;
+}
+
+/*	@brief move setpoints one step toward zero
+ * 	@param wheel_rpm: setpoints of wheels a..d (RPM), updated
+ * 	@param max_step_rpm: largest change of a setpoint
+ * 	@retval: 1 once all the setpoints are zero
+ * */
+uint8_t ramp_to_zero(float wheel_rpm[WHEEL_COUNT], float max_step_rpm)
+{
+	uint8_t stopped = 1;
+
+	for (uint8_t i = 0; i < WHEEL_COUNT; i++)
+	{
+		if (fabsf(wheel_rpm[i]) <= max_step_rpm)
+		{
+			wheel_rpm[i] = 0;
+		}
+		else
+		{
+			wheel_rpm[i] -= (wheel_rpm[i] > 0) ? max_step_rpm : -max_step_rpm;
+			stopped = 0;
+		}
+	}
+
+	return stopped;
+}
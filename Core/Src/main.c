@@ -24,10 +24,24 @@
 /* USER CODE BEGIN Includes */
 
 #include "stdio.h"
+#include <string.h>
 #include "motor_encoder.h"
 #include "pid_control.h"
 #include "motor_control.h"
 #include "NRF24L01.h"
+#include "nrf24_hal.h"
+#include "radio_protocol.h"
+#include "radio_link.h"
+#include "console.h"
+#include "tlog.h"
+#include "microros_transport.h"
+#include "wheel_command.h"
+#include "wheel_state.h"
+#include "wheel_batch.h"
+#include "wheel_tuning.h"
+#include "rover_clock.h"
+#include "kinematics.h"
+#include "command_mux.h"
 
  #include <rcl/rcl.h>
   #include <rcl/error_handling.h>
@@ -41,6 +55,12 @@
   #include<std_msgs/msg/int32_multi_array.h>
   #include<std_msgs/msg/int16_multi_array.h>
   #include<std_msgs/msg/float32_multi_array.h>
+  #include <rover_msgs/msg/wheel_states.h>
+  #include <rover_msgs/msg/wheel_command.h>
+  #include <rover_msgs/msg/odometry.h>
+  #include <rover_msgs/msg/wheel_batch.h>
+  #include <rclc_parameter/rclc_parameter.h>
+  #include <geometry_msgs/msg/twist.h>
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -53,10 +73,20 @@
 #define CMD_RIGHT    8
 #define CMD_STOP     5
 #define CMD_IDLE     0
+
+/* Telemetry sent back to the handheld controller in the ACK payload */
+typedef struct __attribute__((packed))
+{
+	uint8_t seq;         /* incremented on every ACK payload */
+	uint8_t flags;       /* reserved */
+	int16_t velocity[4]; /* wheel velocity a..d in 0.01 RPM */
+	int8_t duty[4];      /* pid output a..d in percent */
+} radio_telemetry;
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define WHEEL_TICK_FLAG 0x0001U  /* thread flag set by TIM5 to start a wheel control step */
 
 /* USER CODE END PD */
 
@@ -135,6 +165,15 @@ const osThreadAttr_t myTask07_attributes = {
   .priority = (osPriority_t) osPriorityAboveNormal6,
 };
 /* USER CODE BEGIN PV */
+console_inst console; /* printf output on USART2 */
+
+/* Definitions for logTask, drains the TLOG records to the console */
+osThreadId_t logTaskHandle;
+const osThreadAttr_t logTask_attributes = {
+  .name = "logTask",
+  .stack_size = 128 * 4,
+  .priority = (osPriority_t) osPriorityLow,
+};
 
 /* USER CODE END PV */
 
@@ -163,6 +202,7 @@ void StartTask06(void *argument);
 void StartTask07(void *argument);
 
 /* USER CODE BEGIN PFP */
+void StartLogTask(void *argument);
 
 /* USER CODE END PFP */
 
@@ -244,10 +284,6 @@ volatile int last_counter_value;
 	    };
 
 
-  int timer_flag_a=0;
-  int timer_flag_b=0;
-  int timer_flag_c=0;
-  int timer_flag_d=0;
   motor_inst motor_a = {
       .htim_motor = &htim9,
       .htim_motor_ch = TIM_CHANNEL_1,
@@ -285,11 +321,48 @@ volatile int last_counter_value;
       .rst_pin_port = GPIOG,
       .rst_pin_number = GPIO_PIN_1
   };
-  int target =15;
+  volatile int target =15;  /* RPM of the legacy radio commands, set from the parameter server */
+  static volatile int test_rpm = 0;  /* amplitude of the test pattern, 0 when off */
   volatile float target_a =0;
   volatile float target_b=0;
   volatile float target_c=0;
   volatile float target_d=0;
+
+  /* control step period of the wheel tasks a..d, and their run-time tuning */
+  static uint16_t wheel_period_ms[WHEEL_COUNT] = {50, 10, 60, 50};
+  static wheel_tuning wheel_tunings[WHEEL_COUNT];
+
+  /* NRF24 on SPI1 receiving the commands, pipe 1 (base) address 0xAABBCCDDEE on channel 10 */
+  static nrf24_hal_bus command_radio_bus = {
+      .hspi = &hspi1,
+      .ce_port = CE_GPIO_Port,
+      .ce_pin = CE_Pin,
+      .csn_port = CSN_GPIO_Port,
+      .csn_pin = CSN_Pin
+  };
+  static nrf24_inst command_radio = {
+      .address = {0xEE, 0xDD, 0xCC, 0xBB, 0xAA},
+      .channel = 10,
+      .ops = &nrf24_hal_ops,
+      .ops_ctx = &command_radio_bus
+  };
+
+  /* NRF24 command sources, one per data pipe. Pipes 2 to 5 share the 4 MSB of the pipe 1 address.
+   * The legacy pipe keeps the setup of the first controllers: address 0xAABBCCDDEE, static 32 byte
+   * payloads carrying an ASCII digit, no auto acknowledge. The binary frame controllers use the others. */
+  enum {
+      RADIO_SRC_LEGACY,
+      RADIO_SRC_OPERATOR,
+      RADIO_SRC_AUTONOMY,
+      RADIO_SRC_SAFETY
+  };
+  static radio_source radio_sources[] = {
+      [RADIO_SRC_LEGACY]   = {.name = "legacy",   .pipe = 2, .address = {0xEE}, .width = 32},
+      [RADIO_SRC_OPERATOR] = {.name = "operator", .pipe = 5, .address = {0xF1}, .width = 0,
+                              .ack_telemetry = 1},
+      [RADIO_SRC_AUTONOMY] = {.name = "autonomy", .pipe = 3, .address = {0xEF}, .width = 0},
+      [RADIO_SRC_SAFETY]   = {.name = "safety",   .pipe = 4, .address = {0xF0}, .width = 0},
+  };
 /* USER CODE END 0 */
 
 /**
@@ -335,6 +408,8 @@ int main(void)
   MX_SPI1_Init();
   MX_USART2_UART_Init();
   /* USER CODE BEGIN 2 */
+  console_init(&console, &huart2);
+  rover_clock_init();
   /* USER CODE END 2 */
 
   /* Init scheduler */
@@ -379,6 +454,7 @@ int main(void)
   myTask07Handle = osThreadNew(StartTask07, NULL, &myTask07_attributes);
 
   /* USER CODE BEGIN RTOS_THREADS */
+  logTaskHandle = osThreadNew(StartLogTask, NULL, &logTask_attributes);
   /* add threads, ... */
   /* USER CODE END RTOS_THREADS */
 
@@ -1134,37 +1210,839 @@ static void MX_GPIO_Init(void)
 /* USER CODE BEGIN 4 */
 PUTCHAR_PROTOTYPE
  {
-   /* Place your implementation of fputc here */
-   /* e.g. write a character to the USART1 and Loop until the end of transmission */
-   HAL_UART_Transmit(&huart3, (uint8_t *)&ch, 1, 0xFFFF);
+   /* Diagnostic output goes to the USART2 console, USART3 carries micro-ROS */
+   uint8_t c = ch;
+   console_write(&console, &c, 1);
 
    return ch;
  }
 
+/* printf hands over whole buffers: queue them at once so a line is either sent or dropped whole */
+int _write(int file, char *ptr, int len)
+{
+  (void)file;
+  console_write(&console, (uint8_t *)ptr, len);
+  return len;
+}
+
 bool cubemx_transport_open(struct uxrCustomTransport * transport);
 bool cubemx_transport_close(struct uxrCustomTransport * transport);
 size_t cubemx_transport_write(struct uxrCustomTransport* transport, const uint8_t * buf, size_t len, uint8_t * err);
 size_t cubemx_transport_read(struct uxrCustomTransport* transport, uint8_t* buf, size_t len, int timeout, uint8_t* err);
 
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	if (huart->Instance == USART3) {
+		cubemx_transport_rx_event(huart);
+	}
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if (huart->Instance == USART3) {
+		cubemx_transport_tx_complete(huart);
+	}
+	else if (huart->Instance == USART2) {
+		console_tx_complete(&console);
+	}
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if (huart->Instance == USART3) {
+		cubemx_transport_error(huart);
+	}
+	else if ((huart->Instance == USART2) && (huart->gState == HAL_UART_STATE_READY)) {
+		/* a DMA error aborted the console chunk, drop it */
+		console_tx_complete(&console);
+	}
+}
+
 void * microros_allocate(size_t size, void * state);
 void microros_deallocate(void * pointer, void * state);
 void * microros_reallocate(void * pointer, size_t size, void * state);
 void * microros_zero_allocate(size_t number_of_elements, size_t size_of_element, void * state);
 
+/* QoS of every topic. Telemetry and high-rate commands go on best-effort streams: a lost sample is
+ * not retransmitted and cannot hold back the samples behind it. Topics missing from the table are
+ * reliable (configuration, services). */
+typedef struct
+{
+	const char *topic;
+	uint8_t best_effort;
+	uint8_t depth;           /* history depth, 1 keeps only the latest sample */
+} topic_qos_entry;
+
+static const topic_qos_entry topic_qos_table[] = {
+	{"wheel_cmd",       1, 1},
+	{"cmd_vel",         1, 1},
+	{"wheel_state",     1, 1},
+	{"odometry",        1, 1},
+	{"wheel_batch",     1, 1},
+	{"transport_stats", 1, 1},
+};
+
+/* @brief QoS profile of a topic from topic_qos_table
+ * @param topic: topic name
+ * @retval: profile, reliable with the default depth for unlisted topics
+ */
+static rmw_qos_profile_t topic_qos(const char *topic)
+{
+	rmw_qos_profile_t qos = rmw_qos_profile_default;
+
+	for (uint8_t i = 0; i < sizeof(topic_qos_table) / sizeof(topic_qos_entry); i++)
+	{
+		if (strcmp(topic_qos_table[i].topic, topic) == 0)
+		{
+			qos.reliability = topic_qos_table[i].best_effort ?
+					RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT : RMW_QOS_POLICY_RELIABILITY_RELIABLE;
+			qos.depth = topic_qos_table[i].depth;
+			break;
+		}
+	}
+
+	return qos;
+}
+
+/* publisher and subscription with the QoS of topic_qos_table */
+static rcl_ret_t create_publisher(rcl_publisher_t *publisher, const rcl_node_t *node,
+		const rosidl_message_type_support_t *type, const char *topic)
+{
+	rmw_qos_profile_t qos = topic_qos(topic);
+	return rclc_publisher_init(publisher, node, type, topic, &qos);
+}
+
+static rcl_ret_t create_subscription(rcl_subscription_t *subscription, const rcl_node_t *node,
+		const rosidl_message_type_support_t *type, const char *topic)
+{
+	rmw_qos_profile_t qos = topic_qos(topic);
+	return rclc_subscription_init(subscription, node, type, topic, &qos);
+}
+
+/* Parameter server: "<wheel>.<field>" for every wheel a..d and field of tuning_fields, plus
+ * "target" (RPM of the radio commands), "ff_gain" (scale of the velocity to duty table) and
+ * "test_rpm" (amplitude of the test pattern command source, 0 to turn it off).
+ * Wheel changes are staged with wheel_tuning and applied by the control tasks at their next step.
+ * ff_gain is one global gain, staged once: only wheel a maps its PID output through the table. */
+#define TUNING_FIELDS   6
+#define FF_GAIN_MAX     2.0
+#define PARAMETER_COUNT (WHEEL_COUNT * TUNING_FIELDS + 3)
+
+static const char *const tuning_fields[TUNING_FIELDS] = {"p", "i", "d", "integral_max", "pid_max", "period_ms"};
+static pid_instance *const wheel_pids[WHEEL_COUNT] = {&mota_pid, &motb_pid, &motc_pid, &motd_pid};
+static wheel_tuning_config tuning_configs[WHEEL_COUNT]; /* settings as last staged */
+static rclc_parameter_server_t parameter_server;
+
+/* @brief declare the parameters with the current settings
+ * @param server: parameter server
+ * @retval: none
+ */
+static void declare_parameters(rclc_parameter_server_t *server)
+{
+	char name[20];
+
+	for (uint8_t wheel = 0; wheel < WHEEL_COUNT; wheel++)
+	{
+		wheel_tuning_config *config = &tuning_configs[wheel];
+
+		get_pid_config(wheel_pids[wheel], &config->pid);
+		config->period_ms = wheel_period_ms[wheel];
+
+		const float values[TUNING_FIELDS - 1] = {config->pid.p_gain, config->pid.i_gain, config->pid.d_gain,
+				config->pid.integral_max, config->pid.pid_max};
+
+		for (uint8_t field = 0; field < TUNING_FIELDS; field++)
+		{
+			snprintf(name, sizeof(name), "%c.%s", 'a' + wheel, tuning_fields[field]);
+			if (field == TUNING_FIELDS - 1)
+			{
+				rclc_add_parameter(server, name, RCLC_PARAMETER_INT);
+				rclc_parameter_set_int(server, name, config->period_ms);
+			}
+			else
+			{
+				rclc_add_parameter(server, name, RCLC_PARAMETER_DOUBLE);
+				rclc_parameter_set_double(server, name, values[field]);
+			}
+		}
+	}
+
+	rclc_add_parameter(server, "target", RCLC_PARAMETER_INT);
+	rclc_parameter_set_int(server, "target", target);
+	rclc_add_parameter(server, "ff_gain", RCLC_PARAMETER_DOUBLE);
+	rclc_parameter_set_double(server, "ff_gain", get_pwm_table_gain());
+	rclc_add_parameter(server, "test_rpm", RCLC_PARAMETER_INT);
+	rclc_parameter_set_int(server, "test_rpm", test_rpm);
+}
+
+/* @brief check and apply a parameter change requested over ROS
+ * @param old_param: current value, NULL for a new parameter
+ * @param new_param: requested value, NULL for a deletion
+ * @param context: not used
+ * @retval: true to accept the change
+ */
+static bool parameter_changed(const Parameter * old_param, const Parameter * new_param, void * context)
+{
+	if (old_param == NULL || new_param == NULL)
+	{
+		return false;
+	}
+
+	const char *name = new_param->name.data;
+	double value = (new_param->value.type == RCLC_PARAMETER_INT) ?
+			(double)new_param->value.integer_value : new_param->value.double_value;
+
+	if (value < 0)
+	{
+		return false;
+	}
+	if (strcmp(name, "target") == 0)
+	{
+		if (value > WHEEL_MAX_RPM)
+		{
+			return false;
+		}
+		target = (int)value;
+		return true;
+	}
+	if (strcmp(name, "ff_gain") == 0)
+	{
+		if (value == 0 || value > FF_GAIN_MAX)
+		{
+			return false;
+		}
+		wheel_tuning_stage_ff_gain(value);
+		return true;
+	}
+	if (strcmp(name, "test_rpm") == 0)
+	{
+		if (value > WHEEL_MAX_RPM)
+		{
+			return false;
+		}
+		test_rpm = (int)value;
+		return true;
+	}
+	if (name[0] < 'a' || name[0] >= 'a' + WHEEL_COUNT || name[1] != '.')
+	{
+		return false;
+	}
+
+	uint8_t wheel = name[0] - 'a';
+	wheel_tuning_config config = tuning_configs[wheel];
+
+	if (strcmp(&name[2], "p") == 0)                 config.pid.p_gain = value;
+	else if (strcmp(&name[2], "i") == 0)            config.pid.i_gain = value;
+	else if (strcmp(&name[2], "d") == 0)            config.pid.d_gain = value;
+	else if (strcmp(&name[2], "integral_max") == 0) config.pid.integral_max = value;
+	else if (strcmp(&name[2], "pid_max") == 0)      config.pid.pid_max = value;
+	else if (strcmp(&name[2], "period_ms") == 0 && value >= 1 && value <= 1000) config.period_ms = value;
+	else return false;
+
+	tuning_configs[wheel] = config;
+	wheel_tuning_stage(&wheel_tunings[wheel], &config);
+	TLOG("param %c changed\n", name[0]);
+	return true;
+}
+
+/* Agent clock synchronisation, the telemetry stamps are in agent time once it succeeded */
+#define CLOCK_SYNC_PERIOD_MS  5000
+#define CLOCK_SYNC_TIMEOUT_MS 20
+
+/* @brief measure the agent clock offset and feed it to rover_clock
+ * @retval: none
+ */
+static void sync_clock(void)
+{
+	if (rmw_uros_sync_session(CLOCK_SYNC_TIMEOUT_MS) != RMW_RET_OK)
+	{
+		TLOG("clock sync failed\n");
+		return;
+	}
+
+	// the offset is measured against clock_gettime, that is the local rover clock
+	uint64_t local_ns = rover_clock_local_ns();
+	rover_clock_sync(rmw_uros_epoch_nanos(), local_ns);
+}
+
+void clock_sync_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	sync_clock();
+}
+
+#define TRANSPORT_STATS_PERIOD_MS 1000
+#define TRANSPORT_STATS_FIELDS    16
+
+static rcl_publisher_t stats_publisher;
+static std_msgs__msg__Int32MultiArray stats_msg;
+static int32_t stats_data[TRANSPORT_STATS_FIELDS];
+
+/* publish the micro-ROS transport counters on "transport_stats", in transport_stats field order */
+void stats_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	const transport_stats *stats = cubemx_transport_get_stats();
+
+	stats_data[0] = stats->bytes_in;
+	stats_data[1] = stats->bytes_out;
+	stats_data[2] = stats->reads;
+	stats_data[3] = stats->read_timeouts;
+	stats_data[4] = stats->rx_overruns;
+	stats_data[5] = stats->tx_rejects;
+	stats_data[6] = stats->framing_errors;
+	stats_data[7] = stats->noise_errors;
+	stats_data[8] = stats->parity_errors;
+	stats_data[9] = stats->uart_overruns;
+	stats_data[10] = stats->dma_errors;
+	stats_data[11] = stats->read_latency_min_us;
+	stats_data[12] = stats->read_latency_avg_us;
+	stats_data[13] = stats->read_latency_max_us;
+	stats_data[14] = stats->tx_queue_depth;
+	stats_data[15] = stats->tx_queue_max;
+
+	stats_msg.data.data = stats_data;
+	stats_msg.data.size = TRANSPORT_STATS_FIELDS;
+	stats_msg.data.capacity = TRANSPORT_STATS_FIELDS;
+	rcl_publish(&stats_publisher, &stats_msg, NULL);
+}
+
+/* Wheel telemetry on "wheel_state" (rover_msgs/WheelStates) and "odometry" (rover_msgs/Odometry),
+ * fixed-size messages filled in place. Every control step also goes to "wheel_batch"
+ * (rover_msgs/WheelBatch), up to WHEEL_BATCH_SIZE steps per message, sent at the latest
+ * WHEEL_BATCH_DEADLINE_MS after the oldest one. The topic is best effort, which cannot fragment: a full
+ * batch serialises to about 20 + 28 * WHEEL_BATCH_SIZE bytes and must stay under the 512 byte XRCE MTU. */
+#define WHEEL_STATE_PERIOD_MS   100
+#define ODOMETRY_PERIOD_MS      100
+#define WHEEL_BATCH_SIZE        16
+#define WHEEL_BATCH_DEADLINE_MS 50
+#define WHEEL_BATCH_POLL_MS     10
+
+static wheel_state wheel_states;
+static rcl_publisher_t wheel_state_publisher;
+static rover_msgs__msg__WheelStates wheel_state_msg;
+static rcl_publisher_t odometry_publisher;
+static rover_msgs__msg__Odometry odometry_msg;
+static wheel_batch wheel_steps;
+static rcl_publisher_t wheel_batch_publisher;
+static rover_msgs__msg__WheelBatch wheel_batch_msg;
+static rover_msgs__msg__WheelSample wheel_batch_data[WHEEL_BATCH_SIZE];
+static wheel_record wheel_batch_records[WHEEL_BATCH_SIZE];
+static uint32_t wheel_batch_unsent;  /* samples of the batches rcl_publish refused */
+
+/* @brief record the result of a control step for the telemetry
+ * @param index: wheel 0..3 (a..d)
+ * @param enc: encoder of the wheel
+ * @param pid: velocity controller of the wheel
+ * @param setpoint: target velocity (RPM)
+ * @param duty: duty given to the driver (%)
+ * @retval: none
+ */
+static void record_wheel(uint8_t index, const encoder_inst *enc, const pid_instance *pid, float setpoint, float duty)
+{
+	wheel_sample sample = {
+		.counts = (int32_t)enc->last_counter_value,
+		.position = enc->position,
+		.velocity = enc->velocity,
+		.setpoint = setpoint,
+		.duty = duty,
+		.stamp_ns = rover_clock_local_ns()
+	};
+
+	if (pid->output >= pid->pid_max || pid->output <= -pid->pid_max)
+	{
+		sample.flags |= WHEEL_SAT_PID;
+	}
+	if (pid->error_integral >= pid->integral_max || pid->error_integral <= -pid->integral_max)
+	{
+		sample.flags |= WHEEL_SAT_INTEGRAL;
+	}
+	if (duty >= 100 || duty <= -100)
+	{
+		sample.flags |= WHEEL_SAT_DUTY;
+	}
+
+	wheel_state_update(&wheel_states, index, &sample);
+	wheel_batch_push(&wheel_steps, index, &sample);
+}
+
+/* publish a snapshot of the four wheels */
+void wheel_state_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	wheel_sample wheels[WHEEL_COUNT];
+
+	wheel_state_snapshot(&wheel_states, wheels);
+
+	wheel_state_msg.stamp_ns = rover_clock_to_agent_ns(rover_clock_local_ns());
+	for (uint8_t i = 0; i < WHEEL_COUNT; i++)
+	{
+		rover_msgs__msg__WheelState *state = &wheel_state_msg.wheels[i];
+
+		state->counts = wheels[i].counts;
+		state->velocity = wheels[i].velocity;
+		state->setpoint = wheels[i].setpoint;
+		state->duty = wheels[i].duty;
+		state->flags = wheels[i].flags; // WHEEL_SAT_* match the SAT_* constants of the message
+	}
+
+	rcl_publish(&wheel_state_publisher, &wheel_state_msg, NULL);
+}
+
+/* publish the distance and ground speed of each wheel */
+void odometry_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	wheel_sample wheels[WHEEL_COUNT];
+
+	wheel_state_snapshot(&wheel_states, wheels);
+
+	odometry_msg.stamp_ns = rover_clock_to_agent_ns(rover_clock_local_ns());
+	for (uint8_t i = 0; i < WHEEL_COUNT; i++)
+	{
+		// RPM and RPM.s to m/s and m
+		odometry_msg.distance[i] = wheels[i].position / 60.0f * WHEEL_CIRCUMFERENCE_M;
+		odometry_msg.speed[i] = wheels[i].velocity / 60.0f * WHEEL_CIRCUMFERENCE_M;
+	}
+
+	rcl_publish(&odometry_publisher, &odometry_msg, NULL);
+}
+
+/* send the queued control steps when a batch is full or its oldest step reached the deadline */
+void wheel_batch_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	while (wheel_batch_due(&wheel_steps, WHEEL_BATCH_SIZE, WHEEL_BATCH_DEADLINE_MS, rover_clock_local_ns()))
+	{
+		uint32_t count = wheel_batch_pop(&wheel_steps, wheel_batch_records, WHEEL_BATCH_SIZE);
+		uint64_t base = wheel_batch_records[0].sample.stamp_ns;
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const wheel_record *record = &wheel_batch_records[i];
+			rover_msgs__msg__WheelSample *sample = &wheel_batch_data[i];
+			uint64_t offset = (record->sample.stamp_ns - base) / 1000;
+
+			sample->wheel = record->wheel;
+			sample->offset_us = (offset > UINT32_MAX) ? UINT32_MAX : offset;
+			sample->counts = record->sample.counts;
+			sample->velocity = record->sample.velocity;
+			sample->setpoint = record->sample.setpoint;
+			sample->duty = record->sample.duty;
+			sample->flags = record->sample.flags;
+		}
+
+		wheel_batch_msg.stamp_ns = rover_clock_to_agent_ns(base);
+		wheel_batch_msg.dropped = wheel_steps.dropped + wheel_batch_unsent;
+		wheel_batch_msg.samples.size = count;
+		if (rcl_publish(&wheel_batch_publisher, &wheel_batch_msg, NULL) != RCL_RET_OK)
+		{
+			wheel_batch_unsent += count;
+			TLOG("wheel_batch: publish failed, %u samples lost\n", count);
+		}
+	}
+}
+
+/* Command sources, highest priority first. Each one holds the wheels for its lease after every
+ * submission, so the radio transmitters repeat their command faster than RADIO_LEASE_MS. When the
+ * lease of cmd_vel runs out its setpoints ramp down at CMD_VEL_RAMP_RPM_PER_S before it lets go, the
+ * other sources stop the motors at once. The mux runs in the default task on every HAL tick. */
+#define RADIO_LEASE_MS           500
+#define WHEEL_COMMAND_TIMEOUT_MS 200
+#define CMD_VEL_TIMEOUT_MS       300
+#define CMD_VEL_RAMP_RPM_PER_S   100
+#define TEST_PATTERN_LEASE_MS    100
+#define TEST_PATTERN_SUBMIT_MS   50    /* submission period of the test pattern */
+#define TEST_PATTERN_HALF_MS     2000  /* the test pattern reverses the wheels this often */
+
+enum {
+	CMD_SRC_SAFETY,
+	CMD_SRC_OPERATOR,
+	CMD_SRC_WHEEL_CMD,
+	CMD_SRC_CMD_VEL,
+	CMD_SRC_AUTONOMY,
+	CMD_SRC_TEST,
+	CMD_SRC_COUNT
+};
+static command_source command_sources[CMD_SRC_COUNT] = {
+	[CMD_SRC_SAFETY]    = {.name = "radio safety",   .priority = 6, .lease_ms = RADIO_LEASE_MS},
+	[CMD_SRC_OPERATOR]  = {.name = "radio operator", .priority = 5, .lease_ms = RADIO_LEASE_MS},
+	[CMD_SRC_WHEEL_CMD] = {.name = "wheel_cmd",      .priority = 4, .lease_ms = WHEEL_COMMAND_TIMEOUT_MS},
+	[CMD_SRC_CMD_VEL]   = {.name = "cmd_vel",        .priority = 3, .lease_ms = CMD_VEL_TIMEOUT_MS,
+	                       .ramp_rpm_per_s = CMD_VEL_RAMP_RPM_PER_S},
+	[CMD_SRC_AUTONOMY]  = {.name = "radio autonomy", .priority = 2, .lease_ms = RADIO_LEASE_MS},
+	[CMD_SRC_TEST]      = {.name = "test pattern",   .priority = 1, .lease_ms = TEST_PATTERN_LEASE_MS},
+};
+static command_mux wheel_mux;
+
+/* @brief submit the test pattern while "test_rpm" is not zero: all wheels at +test_rpm then -test_rpm
+ * @param now: local time in ms
+ * @retval: none
+ */
+static void submit_test_pattern(uint32_t now)
+{
+	static uint32_t last_submit;
+	float wheel[WHEEL_COUNT];
+	float rpm = ((now / TEST_PATTERN_HALF_MS) & 1) ? -test_rpm : test_rpm;
+
+	if ((test_rpm == 0) || (now - last_submit < TEST_PATTERN_SUBMIT_MS))
+	{
+		return;
+	}
+
+	last_submit = now;
+	wheel[0] = wheel[1] = wheel[2] = wheel[3] = rpm;
+	command_mux_submit(&command_sources[CMD_SRC_TEST], wheel, now);
+}
+
+/* Wheel commands from ROS on "wheel_cmd" (rover_msgs/WheelCommand), per-wheel setpoints or a body twist */
+static rover_msgs__msg__WheelCommand wheel_cmd_msg;
 
 void subscription_callback(const void * msgin)
   {
 
-    const std_msgs__msg__Float32MultiArray * msg = (const std_msgs__msg__Float32MultiArray *)msgin;
-
-        // Process the received message
-      //  printf("Received array: ");
-        for (size_t i = 0; i <msg->data.size; i++) {
+    const rover_msgs__msg__WheelCommand * msg = (const rover_msgs__msg__WheelCommand *)msgin;
+    const float *data = msg->setpoint;
+    float wheel[WHEEL_COUNT];
 
-            printf("%.2f ", msg->data.data[i]); // Print float values
+    if (msg->mode == rover_msgs__msg__WheelCommand__MODE_WHEELS)
+    {
+        for (uint8_t i = 0; i < WHEEL_COUNT; i++)
+        {
+            wheel[i] = data[i];
         }
+    }
+    else if (msg->mode == rover_msgs__msg__WheelCommand__MODE_TWIST)
+    {
+        // right wheels (a, c) linear + angular, left wheels (b, d) linear - angular
+        wheel[0] = wheel[2] = data[0] + data[1];
+        wheel[1] = wheel[3] = data[0] - data[1];
+    }
+    else
+    {
+        TLOG("wheel_cmd: unknown mode %u\n", msg->mode);
+        return;
+    }
 
+    command_mux_submit(&command_sources[CMD_SRC_WHEEL_CMD], wheel, HAL_GetTick());
   }
+
+/* Velocity commands from a ROS navigation stack on "cmd_vel" (geometry_msgs/Twist, linear.x in m/s and
+ * angular.z in rad/s), turned into wheel setpoints here */
+static geometry_msgs__msg__Twist cmd_vel_msg;
+
+void cmd_vel_callback(const void * msgin)
+{
+	const geometry_msgs__msg__Twist * msg = (const geometry_msgs__msg__Twist *)msgin;
+	float wheel[WHEEL_COUNT];
+
+	twist_to_wheels((float)msg->linear.x, (float)msg->angular.z, wheel);
+	command_mux_submit(&command_sources[CMD_SRC_CMD_VEL], wheel, HAL_GetTick());
+}
+
+/* Connection to the micro-ROS agent. The entities live in static storage and are created on every
+ * connection, then destroyed when the agent stops answering the pings so that they can be created
+ * again for the next agent without leaking anything. */
+#define AGENT_PING_TIMEOUT_MS  100
+#define AGENT_PING_MIN_MS      50   /* delay between pings while waiting, doubled up to AGENT_PING_MAX_MS */
+#define AGENT_PING_MAX_MS      250
+#define AGENT_CHECK_PERIOD_MS  200  /* ping period while connected */
+#define AGENT_CHECK_ATTEMPTS   3
+
+typedef enum
+{
+	AGENT_WAITING,       /* pinging the agent */
+	AGENT_CONNECTING,    /* creating the entities */
+	AGENT_CONNECTED,     /* spinning */
+	AGENT_DISCONNECTED   /* agent lost, entities to destroy */
+} agent_state;
+
+static rcl_allocator_t ros_allocator;
+static rclc_support_t ros_support;
+static rcl_node_t ros_node;
+static rclc_executor_t ros_executor;
+static rcl_subscription_t wheel_cmd_subscription;
+static rcl_subscription_t cmd_vel_subscription;
+static rcl_timer_t wheel_state_timer;
+static rcl_timer_t odometry_timer;
+static rcl_timer_t clock_sync_timer;
+static rcl_timer_t wheel_batch_timer;
+static rcl_timer_t stats_timer;
+static bool ros_support_ready = false;
+
+/* Executor invocation set, in execution order: the command subscription first so that a command and
+ * telemetry ready in the same period run command first. The executor starts once per EXECUTOR_PERIOD_MS
+ * and sleeps for the rest of the period once the ready handles ran, so a command waits at most one
+ * period and the task never spins for nothing. */
+#define EXECUTOR_PERIOD_MS          5
+#define EXECUTOR_COMMAND_HANDLES    2  /* wheel_cmd, cmd_vel */
+#define EXECUTOR_TELEMETRY_HANDLES  3  /* wheel_state, odometry, wheel_batch timers */
+#define EXECUTOR_DIAGNOSTIC_HANDLES 2  /* transport_stats, clock sync timers */
+#define EXECUTOR_HANDLES            (EXECUTOR_COMMAND_HANDLES + EXECUTOR_TELEMETRY_HANDLES + \
+                                     EXECUTOR_DIAGNOSTIC_HANDLES + RCLC_PARAMETER_EXECUTOR_HANDLES_NUMBER)
+
+#define ENTITY_CHECK(call) if ((call) != RCL_RET_OK) { TLOG("micro-ROS setup failed, line %u\n", __LINE__); return false; }
+
+/* @brief create the node, its entities and the executor
+ * @retval: true on success, destroy_entities cleans up after a failure
+ */
+static bool create_entities(void)
+{
+	ros_allocator = rcl_get_default_allocator();
+	ros_executor = rclc_executor_get_zero_initialized_executor();
+
+	ENTITY_CHECK(rclc_support_init(&ros_support, 0, NULL, &ros_allocator));
+	ros_support_ready = true;
+	ENTITY_CHECK(rclc_node_init_default(&ros_node, "cubemx_node", "", &ros_support));
+
+	// Controller tuning, the parameter services stay reliable
+	const rclc_parameter_options_t parameter_options = {
+	    .notify_changed_over_dds = false,
+	    .max_params = PARAMETER_COUNT,
+	    .allow_undeclared_parameters = false,
+	    .low_mem_mode = true
+	};
+	ENTITY_CHECK(rclc_parameter_server_init_with_option(&parameter_server, &ros_node, &parameter_options));
+	declare_parameters(&parameter_server);
+
+	// Wheel telemetry, published at a fixed rate from preallocated storage
+	ENTITY_CHECK(create_publisher(&wheel_state_publisher, &ros_node, ROSIDL_GET_MSG_TYPE_SUPPORT(rover_msgs, msg, WheelStates), "wheel_state"));
+	ENTITY_CHECK(rclc_timer_init_default(&wheel_state_timer, &ros_support, RCL_MS_TO_NS(WHEEL_STATE_PERIOD_MS), wheel_state_timer_callback));
+	ENTITY_CHECK(create_publisher(&odometry_publisher, &ros_node, ROSIDL_GET_MSG_TYPE_SUPPORT(rover_msgs, msg, Odometry), "odometry"));
+	ENTITY_CHECK(rclc_timer_init_default(&odometry_timer, &ros_support, RCL_MS_TO_NS(ODOMETRY_PERIOD_MS), odometry_timer_callback));
+
+	// Telemetry stamps in agent time, synchronised now and then periodically
+	sync_clock();
+	ENTITY_CHECK(rclc_timer_init_default(&clock_sync_timer, &ros_support, RCL_MS_TO_NS(CLOCK_SYNC_PERIOD_MS), clock_sync_timer_callback));
+
+	// Batches of control steps, the sequence points to static storage
+	wheel_batch_msg.samples.data = wheel_batch_data;
+	wheel_batch_msg.samples.capacity = WHEEL_BATCH_SIZE;
+	ENTITY_CHECK(create_publisher(&wheel_batch_publisher, &ros_node, ROSIDL_GET_MSG_TYPE_SUPPORT(rover_msgs, msg, WheelBatch), "wheel_batch"));
+	ENTITY_CHECK(rclc_timer_init_default(&wheel_batch_timer, &ros_support, RCL_MS_TO_NS(WHEEL_BATCH_POLL_MS), wheel_batch_timer_callback));
+
+	// Wheel and velocity commands
+	ENTITY_CHECK(create_subscription(&wheel_cmd_subscription, &ros_node, ROSIDL_GET_MSG_TYPE_SUPPORT(rover_msgs, msg, WheelCommand), "wheel_cmd"));
+	ENTITY_CHECK(create_subscription(&cmd_vel_subscription, &ros_node, ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, Twist), "cmd_vel"));
+
+	// Transport health counters, published periodically
+	ENTITY_CHECK(create_publisher(&stats_publisher, &ros_node, ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32MultiArray), "transport_stats"));
+	ENTITY_CHECK(rclc_timer_init_default(&stats_timer, &ros_support, RCL_MS_TO_NS(TRANSPORT_STATS_PERIOD_MS), stats_timer_callback));
+
+	ENTITY_CHECK(rclc_executor_init(&ros_executor, &ros_support.context, EXECUTOR_HANDLES, &ros_allocator));
+	ENTITY_CHECK(rclc_executor_add_subscription(&ros_executor, &wheel_cmd_subscription, &wheel_cmd_msg, &subscription_callback, ON_NEW_DATA));
+	ENTITY_CHECK(rclc_executor_add_subscription(&ros_executor, &cmd_vel_subscription, &cmd_vel_msg, &cmd_vel_callback, ON_NEW_DATA));
+	ENTITY_CHECK(rclc_executor_add_timer(&ros_executor, &wheel_state_timer));
+	ENTITY_CHECK(rclc_executor_add_timer(&ros_executor, &odometry_timer));
+	ENTITY_CHECK(rclc_executor_add_timer(&ros_executor, &wheel_batch_timer));
+	ENTITY_CHECK(rclc_executor_add_timer(&ros_executor, &stats_timer));
+	ENTITY_CHECK(rclc_executor_add_timer(&ros_executor, &clock_sync_timer));
+	ENTITY_CHECK(rclc_executor_add_parameter_server(&ros_executor, &parameter_server, parameter_changed));
+
+	// any ready handle wakes the executor, the wait lasts at most one period
+	ENTITY_CHECK(rclc_executor_set_trigger(&ros_executor, rclc_executor_trigger_any, NULL));
+	ENTITY_CHECK(rclc_executor_set_timeout(&ros_executor, RCL_MS_TO_NS(EXECUTOR_PERIOD_MS)));
+
+	return true;
+}
+
+/* @brief release everything create_entities made, without waiting for an agent that is gone
+ * @retval: none
+ */
+static void destroy_entities(void)
+{
+	if (!ros_support_ready)
+	{
+		return;
+	}
+
+	rmw_context_t * rmw_context = rcl_context_get_rmw_context(&ros_support.context);
+	(void) rmw_uros_set_context_entity_destroy_session_timeout(rmw_context, 0);
+
+	(void) rclc_executor_fini(&ros_executor);
+	(void) rcl_timer_fini(&stats_timer);
+	(void) rcl_timer_fini(&wheel_batch_timer);
+	(void) rcl_timer_fini(&clock_sync_timer);
+	(void) rcl_timer_fini(&odometry_timer);
+	(void) rcl_timer_fini(&wheel_state_timer);
+	(void) rcl_subscription_fini(&cmd_vel_subscription, &ros_node);
+	(void) rcl_subscription_fini(&wheel_cmd_subscription, &ros_node);
+	(void) rcl_publisher_fini(&stats_publisher, &ros_node);
+	(void) rcl_publisher_fini(&wheel_batch_publisher, &ros_node);
+	(void) rcl_publisher_fini(&odometry_publisher, &ros_node);
+	(void) rcl_publisher_fini(&wheel_state_publisher, &ros_node);
+	(void) rclc_parameter_server_fini(&parameter_server, &ros_node);
+	(void) rcl_node_fini(&ros_node);
+	(void) rclc_support_fini(&ros_support);
+	ros_support_ready = false;
+}
+
+/* @brief setpoints of a legacy ASCII radio command
+ * @param command: one of the CMD_* codes
+ * @param wheel: setpoints a..d (RPM), all zero for STOP and IDLE
+ * @retval: none
+ */
+static void radio_command(int8_t command, float wheel[WHEEL_COUNT])
+{
+	switch (command)
+	{
+	    case CMD_FORWARD:
+	        TLOG("Command: FORWARD\n");
+	        wheel[0] = wheel[1] = wheel[2] = wheel[3] = target;
+	        break;
+
+	    case CMD_BACKWARD:
+	        TLOG("Command: BACKWARD\n");
+	        wheel[0] = wheel[1] = wheel[2] = wheel[3] = -target;
+	        break;
+
+	    case CMD_LEFT:
+	        TLOG("Command: LEFT\n");
+	        wheel[0] = wheel[2] = target;
+	        wheel[1] = wheel[3] = -target;
+	        break;
+
+	    case CMD_RIGHT:
+	        TLOG("Command: RIGHT\n");
+	        wheel[0] = wheel[2] = -target;
+	        wheel[1] = wheel[3] = target;
+	        break;
+
+	    case CMD_STOP:
+	        TLOG("Command: STOP\n");
+	        wheel[0] = wheel[1] = wheel[2] = wheel[3] = 0;
+	        break;
+
+	    case CMD_IDLE:
+	        TLOG("Command: IDLE\n");
+	    default:
+	        wheel[0] = wheel[1] = wheel[2] = wheel[3] = 0;
+	        break;
+	}
+}
+
+/* @brief setpoints of a validated binary command frame
+ * @param header: frame header
+ * @param payload: frame payload, its layout depends on header->type
+ * @param wheel: setpoints a..d (RPM), all zero for a STOP frame
+ * @retval: none
+ */
+static void radio_frame(const radio_frame_header *header, const uint8_t *payload, float wheel[WHEEL_COUNT])
+{
+	switch (header->type)
+	{
+		case RADIO_FRAME_TWIST:
+		{
+			const radio_twist_payload *twist = (const radio_twist_payload *)payload;
+			float linear = twist->linear / 100.0f;
+			float angular = twist->angular / 100.0f;
+			// a and c are the right hand wheels, b and d the left hand ones
+			wheel[0] = wheel[2] = linear + angular;
+			wheel[1] = wheel[3] = linear - angular;
+			break;
+		}
+
+		case RADIO_FRAME_WHEELS:
+		{
+			const radio_wheels_payload *wheels = (const radio_wheels_payload *)payload;
+			for (uint8_t i = 0; i < WHEEL_COUNT; i++)
+			{
+				wheel[i] = wheels->wheel[i] / 100.0f;
+			}
+			break;
+		}
+
+		case RADIO_FRAME_STOP:
+		default:
+			radio_command(CMD_STOP, wheel);
+			break;
+	}
+}
+
+/* @brief submit a command from one of the radio sources to the mux
+ * @param source: source the command came from
+ * @param header: binary frame header, NULL for a legacy ASCII command
+ * @param payload: frame payload, or the raw data for a legacy command
+ * @param len: number of bytes received
+ * @retval: none
+ */
+static void radio_source_command(radio_source *source, const radio_frame_header *header,
+		const uint8_t *payload, uint8_t len)
+{
+	// the legacy controllers are operator consoles as well, both pipes are read by this task only
+	static const uint8_t mux_sources[] = {
+		[RADIO_SRC_LEGACY]   = CMD_SRC_OPERATOR,
+		[RADIO_SRC_OPERATOR] = CMD_SRC_OPERATOR,
+		[RADIO_SRC_AUTONOMY] = CMD_SRC_AUTONOMY,
+		[RADIO_SRC_SAFETY]   = CMD_SRC_SAFETY,
+	};
+	float wheel[WHEEL_COUNT];
+
+	TLOG("Received Data from pipe %u\n", source->pipe); // Debugging output
+
+	// whatever the safety transmitter sends means stop
+	if (source == &radio_sources[RADIO_SRC_SAFETY])
+	{
+		radio_command(CMD_STOP, wheel);
+	}
+	else if (header != NULL)
+	{
+		radio_frame(header, payload, wheel);
+	}
+	else
+	{
+		radio_command(payload[0] - 0x30, wheel);
+	}
+
+	command_mux_submit(&command_sources[mux_sources[source - radio_sources]], wheel, HAL_GetTick());
+}
+
+/* @brief drive the wheels with the mux output, all zero setpoints stop the motors
+ * @param wheel: setpoints a..d (RPM)
+ * @retval: none
+ */
+static void apply_setpoints(const float wheel[WHEEL_COUNT])
+{
+	target_a = wheel[0];
+	target_b = wheel[1];
+	target_c = wheel[2];
+	target_d = wheel[3];
+
+	if ((wheel[0] == 0) && (wheel[1] == 0) && (wheel[2] == 0) && (wheel[3] == 0))
+	{
+		disable_motor(&motor_a);
+		disable_motor(&motor_b);
+		disable_motor(&motor_c);
+		disable_motor(&motor_d);
+	}
+	else
+	{
+		enable_motor(&motor_a);
+		enable_motor(&motor_b);
+		enable_motor(&motor_c);
+		enable_motor(&motor_d);
+	}
+}
+
+/* @brief move the TLOG records to the console as room frees up
+ * @param argument: not used
+ * @retval: none
+ */
+void StartLogTask(void *argument)
+{
+	uint8_t chunk[64];
+
+	for(;;)
+	{
+		uint16_t room = console_free(&console);
+		uint16_t len = tlog_drain(chunk, (room < sizeof(chunk)) ? room : sizeof(chunk));
+
+		if (len != 0)
+		{
+			console_write(&console, chunk, len);
+		}
+		else
+		{
+			osDelay(10);
+		}
+	}
+}
+
 /* USER CODE END 4 */
 
 /* USER CODE BEGIN Header_StartDefaultTask */
@@ -1177,122 +2055,53 @@ void subscription_callback(const void * msgin)
 void StartDefaultTask(void *argument)
 {
   /* USER CODE BEGIN 5 */
-	  uint8_t RxAddress[] = {0xEE,0xDD,0xCC,0xBB,0xAA};
-	  uint8_t RxData[32];
 	  uint8_t data[50];
-	  NRF24_Init();
-	  NRF24_RxMode(RxAddress, 10);
-	  NRF24_ReadAll(data);
+	  radio_telemetry telemetry = {0};
+	  uint32_t mux_tick = HAL_GetTick();
+	  command_mux_init(&wheel_mux, command_sources, CMD_SRC_COUNT);
+	  NRF24_Init(&command_radio);
+	  radio_link_init(&command_radio, radio_sources, sizeof(radio_sources) / sizeof(radio_source));
+	  NRF24_ReadAll(&command_radio, data);
 
 	  while (1)
 	  {
-		if (isDataAvailable(2) == 1)
+		 // drain the RX FIFO of all pipes, the ACK payload below goes out with the next packet
+		 uint8_t received = radio_link_poll(radio_source_command, HAL_GetTick());
+		 if (received)
 		 	  {
-			 NRF24_Receive(RxData); // Receive data
-			 printf("Received Data: %d\n", RxData); // Debugging output
-
-			  // Parse command (assuming first byte is the command)
-			 if (RxData[0] != '\0')
-			  {
-			      int8_t command = RxData[0] - 0x30;
-
-
-	    //  command=2;
-
-			             switch (command)
-			             {
-			                 case CMD_FORWARD:
-			                   printf("Command: FORWARD\n");
-			                    // disable_motor(&motor_a);
-			                    // disable_motor(&motor_b);
-			                  //   disable_motor(&motor_c);
-			                   //  disable_motor(&motor_d);
-			                     target_a = target; // Set target speed
-			                     target_b = target;
-			                     target_c = target;
-			                     target_d =target;
-			                     enable_motor(&motor_a);
-			                     enable_motor(&motor_b);
-			                     enable_motor(&motor_c);
-			                     enable_motor(&motor_d);
-			                     break;
-
-			                 case CMD_BACKWARD:
-			                     printf("Command: BACKWARD\n");
-
-			                    // disable_motor(&motor_a);
-			                     //disable_motor(&motor_b);
-			                     //disable_motor(&motor_c);
-			                     //disable_motor(&motor_d);
-			                     target_a = -target; // Set negative target for reverse
-			                     target_b = -target;
-			                     target_c = -target;
-			                     target_d = -target;
-			                     enable_motor(&motor_a);
-			                     enable_motor(&motor_b);
-			                     enable_motor(&motor_c);
-			                     enable_motor(&motor_d);
-			                     break;
-
-			                 case CMD_LEFT:
-			                     printf("Command: LEFT\n");
-			                     disable_motor(&motor_a);
-			                     disable_motor(&motor_b);
-			                     disable_motor(&motor_c);
-			                     disable_motor(&motor_d);
-			                     target_a = target ; // Reduce speed or reverse for turning
-			                     target_b =  -target ;
-			                     target_c = target;
-			                     target_d = - target;
-			                     enable_motor(&motor_a);
-			                     enable_motor(&motor_b);
-			                     enable_motor(&motor_c);
-			                     enable_motor(&motor_d);
-
-			                     break;
-
-			                 case CMD_RIGHT:
-			                     printf("Command: RIGHT\n");
-			                     disable_motor(&motor_a);
-			                     disable_motor(&motor_b);
-			                     disable_motor(&motor_c);
-			                     disable_motor(&motor_d);
-			                     target_a = - target ;
-			                     target_b = target ;
-			                     target_c =  -target;
-			                     target_d = target;
-			                     enable_motor(&motor_a);
-			                     enable_motor(&motor_b);
-			                     enable_motor(&motor_c);
-			                     enable_motor(&motor_d);
-			                     break;
-
-			                 case CMD_STOP:
-			                     printf("Command: STOP\n");
-
-
-			                     target_a = 0;
-			                     target_b = 0;
-			                     target_c = 0;
-			                     target_d = 0;
-			                     disable_motor(&motor_a);
-			                     disable_motor(&motor_b);
-			                     disable_motor(&motor_c);
-			                     disable_motor(&motor_d);
-
-			                     break;
-			                 case CMD_IDLE:
-			                	 printf("Command: IDLE\n");
-			                 default:
-			                	 target_a = 0;
-			                	 target_b = 0;
-			                	 target_c = 0;
-			                	 target_d = 0;
-			                	 break;
-
-			             }
-			}
+			 telemetry.seq++;
+			 telemetry.velocity[0] = (int16_t)(motora_enc.velocity * 100);
+			 telemetry.velocity[1] = (int16_t)(motorb_enc.velocity * 100);
+			 telemetry.velocity[2] = (int16_t)(motorc_enc.velocity * 100);
+			 telemetry.velocity[3] = (int16_t)(motord_enc.velocity * 100);
+			 telemetry.duty[0] = (int8_t)mota_pid.output;
+			 telemetry.duty[1] = (int8_t)motb_pid.output;
+			 telemetry.duty[2] = (int8_t)motc_pid.output;
+			 telemetry.duty[3] = (int8_t)motd_pid.output;
+			 radio_link_ack(received, (uint8_t *)&telemetry, sizeof(telemetry));
 		 	  }
+
+		 // one arbitration per control tick, the mux output is the only writer of the wheel targets
+		 uint32_t now = HAL_GetTick();
+		 submit_test_pattern(now);
+		 if (now != mux_tick)
+		 {
+			 mux_tick = now;
+			 uint8_t result = command_mux_tick(&wheel_mux, now);
+
+			 if (result & COMMAND_MUX_TRANSITION)
+			 {
+				 // source indices of command_sources, -1 for none
+				 TLOG("mux: source %d -> %d (%u)\n", wheel_mux.previous, wheel_mux.active, wheel_mux.transitions);
+			 }
+			 if (result & COMMAND_MUX_CHANGED)
+			 {
+				 apply_setpoints(wheel_mux.output);
+			 }
+		 }
+
+		 // the mux only runs once per tick, sleep until the next one so that the lower priority tasks run
+		 osDelay(1);
 	  }
 
 
@@ -1317,9 +2126,9 @@ void StartTask02(void *argument)
 
 	for(;;)
 	   {
-	if (timer_flag_b) // Replace with a semaphore for better control
+	if (osThreadFlagsWait(WHEEL_TICK_FLAG, osFlagsWaitAny, osWaitForever) == WHEEL_TICK_FLAG)
 	        {
-		timer_flag_b= 0;
+		wheel_tuning_apply(&wheel_tunings[1], &motb_pid, &wheel_period_ms[1]);
 	            get_encoder_speed(&motorb_enc);
 	            float current_velocity = motorb_enc.velocity;
 	            apply_pid(&motb_pid,target_b- current_velocity);
@@ -1327,8 +2136,9 @@ void StartTask02(void *argument)
 	           pwm_duty = pwm_duty < 0 ? 0 : (pwm_duty > 100 ? 100 : pwm_duty); // Clamp duty cycle
 	          // set_speed_open(&motor_b, pwm_duty);
 	           set_speed_open((motor_inst*)&motor_b, motb_pid.output);
+	           record_wheel(1, &motorb_enc, &motb_pid, target_b, motb_pid.output);
 	           // set_speed_open(&motor_d, pwm_duty);
-	       osDelay(10);
+	       osDelay(wheel_period_ms[1]);
 
 
 	        }
@@ -1353,18 +2163,19 @@ void StartTask03(void *argument)
 
   for(;;)
   {
-	  if (timer_flag_c) // Replace with a semaphore for better control
+	  if (osThreadFlagsWait(WHEEL_TICK_FLAG, osFlagsWaitAny, osWaitForever) == WHEEL_TICK_FLAG)
 	  	        {
-		  timer_flag_c= 0;
+		  wheel_tuning_apply(&wheel_tunings[2], &motc_pid, &wheel_period_ms[2]);
 	  	            get_encoder_speed(&motorc_enc);
 	  	            float current_velocity = motorc_enc.velocity;
 	  	            apply_pid(&motc_pid,  current_velocity- target_c);
 	  	            float pwm_duty = get_pwm_from_velocity(motc_pid.output);
 	  	          //  pwm_duty = pwm_duty < 0 ? 0 : (pwm_duty > 100 ? 100 : pwm_duty); // Clamp duty cycle
 	  	            set_speed_open(&motor_c, motc_pid.output);
+	  	            record_wheel(2, &motorc_enc, &motc_pid, target_c, motc_pid.output);
 	  	        //  set_speed_open(&motor_c, pwm_duty);
 	  	         // printf("mot=%f \n", motorc_enc.velocity);
-	  	        osDelay(60);
+	  	        osDelay(wheel_period_ms[2]);
 	  	        }
 
   }
@@ -1387,16 +2198,17 @@ void StartTask04(void *argument)
 	volatile float target_speed = 0;
 	for(;;)
 	{
-		if (timer_flag_d) // Replace with a semaphore for better control
+		if (osThreadFlagsWait(WHEEL_TICK_FLAG, osFlagsWaitAny, osWaitForever) == WHEEL_TICK_FLAG)
 		        {
-			timer_flag_d = 0;
+			wheel_tuning_apply(&wheel_tunings[3], &motd_pid, &wheel_period_ms[3]);
 		            get_encoder_speed(&motord_enc);
 		            float current_velocity = motord_enc.velocity;
 		            apply_pid(&motd_pid, current_velocity- target_d);
 		            float pwm_duty = get_pwm_from_velocity(motd_pid.output);
 		            set_speed_open(&motor_d,motd_pid.output);
+		            record_wheel(3, &motord_enc, &motd_pid, target_d, motd_pid.output);
 		            //set_speed_open(&motor_d, pwm_duty);
-		        osDelay(50);
+		        osDelay(wheel_period_ms[3]);
 
 		        }
 
@@ -1429,8 +2241,9 @@ void StartTask05(void *argument)
   {
 
 
- while(timer_flag_a){
-	 timer_flag_a=0;
+ if (osThreadFlagsWait(WHEEL_TICK_FLAG, osFlagsWaitAny, osWaitForever) == WHEEL_TICK_FLAG){
+	 wheel_tuning_apply(&wheel_tunings[0], &mota_pid, &wheel_period_ms[0]);
+	 wheel_tuning_apply_ff_gain();
 	  get_encoder_speed(&motora_enc);
 	  float  temp_velocity = motora_enc.velocity;
 	  apply_pid(&mota_pid,target_a-temp_velocity);
@@ -1438,7 +2251,8 @@ void StartTask05(void *argument)
 	pwm_duty=get_pwm_from_velocity(mota_pid.output);
 	//set_speed_open((motor_inst*)&motor_a, mota_pid.output);
 	set_speed_open((motor_inst*)&motor_a, pwm_duty);
-	osDelay(50);
+	record_wheel(0, &motora_enc, &mota_pid, target_a, pwm_duty);
+	osDelay(wheel_period_ms[0]);
  }
   }
   /* USER CODE END StartTask05 */
@@ -1473,82 +2287,79 @@ void StartTask06(void *argument)
 void StartTask07(void *argument)
 {
   /* USER CODE BEGIN StartTask07 */
+	rmw_uros_set_custom_transport(
+	       true,
+	       (void *) &huart3,
+	       cubemx_transport_open,
+	       cubemx_transport_close,
+	       cubemx_transport_write,
+	       cubemx_transport_read);
+
+	rcl_allocator_t freeRTOS_allocator = rcutils_get_zero_initialized_allocator();
+	freeRTOS_allocator.allocate = microros_allocate;
+	freeRTOS_allocator.deallocate = microros_deallocate;
+	freeRTOS_allocator.reallocate = microros_reallocate;
+	freeRTOS_allocator.zero_allocate =  microros_zero_allocate;
+
+	if (!rcutils_set_default_allocator(&freeRTOS_allocator)) {
+	    printf("Error on default allocators (line %d)\n", __LINE__);
+	}
+
+	agent_state state = AGENT_WAITING;
+	uint32_t ping_delay = AGENT_PING_MIN_MS;
+	uint32_t last_check = 0;
+
   /* Infinite loop */
   for(;;)
   {
-	     rmw_uros_set_custom_transport(
-	            true,
-	            (void *) &huart3,
-	            cubemx_transport_open,
-	            cubemx_transport_close,
-	            cubemx_transport_write,
-	            cubemx_transport_read);
-
-	          rcl_allocator_t freeRTOS_allocator = rcutils_get_zero_initialized_allocator();
-	          freeRTOS_allocator.allocate = microros_allocate;
-	          freeRTOS_allocator.deallocate = microros_deallocate;
-	          freeRTOS_allocator.reallocate = microros_reallocate;
-	          freeRTOS_allocator.zero_allocate =  microros_zero_allocate;
-
-	          if (!rcutils_set_default_allocator(&freeRTOS_allocator)) {
-	              printf("Error on default allocators (line %d)\n", __LINE__);
-	          }
-
-	          // Declare variables
-	              rcl_publisher_t publisher;
-	              std_msgs__msg__Float32MultiArray msg1; // Define the message instance for Float32MultiArray
-	              rclc_support_t support;
-	              rcl_allocator_t allocator;
-	              rcl_node_t node;
-	              rcl_subscription_t subscriber;
-
-	              // Initialize micro-ROS allocator
-	              allocator = rcl_get_default_allocator();
-
-	              // Create init_options
-	              rclc_support_init(&support, 0, NULL, &allocator);
-
-	              // Create node
-	              rclc_node_init_default(&node, "cubemx_node", "", &support);
-
-	              // Create publisher (if needed)
-	              rclc_publisher_init_default(&publisher, &node, ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Float32), "dummy_publisher");
-
-	              // Create subscription
-	              const char * topic_name = "subscriber1"; // Topic to subscribe to
-	              rclc_subscription_init_default(
-	                  &subscriber,
-	                  &node,
-	                  ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Float32MultiArray),
-	                  topic_name);
-
-	              // Initialize message data structure
-	              msg1.data.size = 0; // Initially set size to 0
-	              msg1.data.capacity = 6; // Set capacity of the array
-	              msg1.data.data = (float *)malloc(msg1.data.capacity * sizeof(float)); // Allocate memory for float array
-
-	              // Initialize executor
-	              rclc_executor_t executor;
-	              rclc_executor_init(&executor, &support.context, 1, &allocator);
-
-	              // Add subscription to executor
-	              rclc_executor_add_subscription(&executor, &subscriber, &msg1, &subscription_callback, ON_NEW_DATA);
-
-	              for(;;) {
-	                  // Spin executor to handle incoming messages
-	                  rclc_executor_spin_some(&executor, RCL_MS_TO_NS(10)); // Handle callbacks
-
-	                  /* USER CODE END StartDefaultTask */
-
-	                  // Optional: Add other application logic here
-	                 // osDelay(10); // Adjust delay as needed for your application
-	              }
-
-	              // Free allocated memory before exiting (if applicable)
-	              free(msg1.data.data);
-
-
-
+	  switch (state)
+	  {
+	  case AGENT_WAITING:
+		  if (rmw_uros_ping_agent(AGENT_PING_TIMEOUT_MS, 1) == RMW_RET_OK)
+		  {
+			  ping_delay = AGENT_PING_MIN_MS;
+			  state = AGENT_CONNECTING;
+		  }
+		  else
+		  {
+			  osDelay(ping_delay);
+			  ping_delay = (2 * ping_delay < AGENT_PING_MAX_MS) ? 2 * ping_delay : AGENT_PING_MAX_MS;
+		  }
+		  break;
+
+	  case AGENT_CONNECTING:
+		  if (create_entities())
+		  {
+			  TLOG("micro-ROS agent connected\n");
+			  last_check = HAL_GetTick();
+			  state = AGENT_CONNECTED;
+		  }
+		  else
+		  {
+			  destroy_entities();
+			  state = AGENT_WAITING;
+		  }
+		  break;
+
+	  case AGENT_CONNECTED:
+		  rclc_executor_spin_one_period(&ros_executor, RCL_MS_TO_NS(EXECUTOR_PERIOD_MS));
+		  if (HAL_GetTick() - last_check >= AGENT_CHECK_PERIOD_MS)
+		  {
+			  last_check = HAL_GetTick();
+			  if (rmw_uros_ping_agent(AGENT_PING_TIMEOUT_MS, AGENT_CHECK_ATTEMPTS) != RMW_RET_OK)
+			  {
+				  state = AGENT_DISCONNECTED;
+			  }
+		  }
+		  break;
+
+	  case AGENT_DISCONNECTED:
+	  default:
+		  TLOG("micro-ROS agent lost\n");
+		  destroy_entities();
+		  state = AGENT_WAITING;
+		  break;
+	  }
   }
   /* USER CODE END StartTask07 */
 }
@@ -1572,10 +2383,12 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
   /* USER CODE BEGIN Callback 1 */
   /* USER CODE END Callback 0 */
     if (htim->Instance == TIM5) {
-    	 timer_flag_a=1;
-    	 timer_flag_b=1;
-    	 timer_flag_c=1;
-    	 timer_flag_d=1;
+    	 rover_clock_update();
+    	 // wake the wheel tasks a..d, a flag set during their osDelay ends the next wait at once
+    	 osThreadFlagsSet(myTask05Handle, WHEEL_TICK_FLAG);
+    	 osThreadFlagsSet(myTask02Handle, WHEEL_TICK_FLAG);
+    	 osThreadFlagsSet(myTask03Handle, WHEEL_TICK_FLAG);
+    	 osThreadFlagsSet(myTask04Handle, WHEEL_TICK_FLAG);
     }
 
   /* USER CODE END Callback 1 */
@@ -1,10 +1,12 @@
 #include <unistd.h>
 #include <time.h>
 #include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rover_clock.h"
 
 #define MICROSECONDS_PER_SECOND    ( 1000000LL )                                   /**< Microseconds per second. */
 #define NANOSECONDS_PER_SECOND     ( 1000000000LL )                                /**< Nanoseconds per second. */
-#define NANOSECONDS_PER_TICK       ( NANOSECONDS_PER_SECOND / configTICK_RATE_HZ ) /**< Nanoseconds per FreeRTOS tick. */
 
 void UTILS_NanosecondsToTimespec( int64_t llSource,
                                   struct timespec * const pxDestination )
@@ -29,29 +31,22 @@ void UTILS_NanosecondsToTimespec( int64_t llSource,
 int clock_gettime( int clock_id,
                    struct timespec * tp )
 {
-    TimeOut_t xCurrentTime = { 0 };
-
-    /* Intermediate variable used to convert TimeOut_t to struct timespec.
-     * Also used to detect overflow issues. It must be unsigned because the
-     * behavior of signed integer overflow is undefined. */
-    uint64_t ullTickCount = 0ULL;
-
     /* Silence warnings about unused parameters. */
     ( void ) clock_id;
 
-    /* Get the current tick count and overflow count. vTaskSetTimeOutState()
-     * is used to get these values because they are both static in tasks.c. */
-    vTaskSetTimeOutState( &xCurrentTime );
+    /* Local rover clock for every clock id: micro-XRCE-DDS measures the agent offset against this
+     * time in rmw_uros_sync_session, so it must not be stepped by the synchronisation itself.
+     * Agent time is rover_clock_to_agent_ns(). */
+    UTILS_NanosecondsToTimespec( ( int64_t ) rover_clock_local_ns(), tp );
 
-    /* Adjust the tick count for the number of times a TickType_t has overflowed.
-     * portMAX_DELAY should be the maximum value of a TickType_t. */
-    ullTickCount = ( uint64_t ) ( xCurrentTime.xOverflowCount ) << ( sizeof( TickType_t ) * 8 );
-
-    /* Add the current tick count. */
-    ullTickCount += xCurrentTime.xTimeOnEntering;
+    return 0;
+}
 
-    /* Convert ullTickCount to timespec. */
-    UTILS_NanosecondsToTimespec( ( int64_t ) ullTickCount * NANOSECONDS_PER_TICK, tp );
+/* Used by rclc_sleep_ms, so by rclc_executor_spin_one_period to wait for the next period.
+ * Rounded up to whole ticks: a task never sleeps less than asked. */
+int usleep( useconds_t usec )
+{
+    vTaskDelay( ( TickType_t ) ( ( ( uint64_t ) usec * configTICK_RATE_HZ + MICROSECONDS_PER_SECOND - 1 ) / MICROSECONDS_PER_SECOND ) );
 
     return 0;
-}
\ No newline at end of file
+}
@@ -3,70 +3,394 @@
 #include <rmw_microxrcedds_c/config.h>
 
 #include "main.h"
+#include "microros_transport.h"
+#include "byte_ring.h"
+#include "critical.h"
 #include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
 
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
 #ifdef RMW_UXRCE_TRANSPORT_CUSTOM
 
 // --- micro-ROS Transports ---
+// RX ring filled by the circular DMA. Its head follows the DMA position, at least twice per lap thanks to
+// the half/full transfer events, so the writer lapping the reader shows up as more than a buffer of pending data.
+// Both ring sizes are powers of two, overridable for the host benchmark (tests/bench_dma_transport.c)
+#ifndef UART_DMA_BUFFER_SIZE
 #define UART_DMA_BUFFER_SIZE 2048
+#endif
 
 static uint8_t dma_buffer[UART_DMA_BUFFER_SIZE];
-static size_t dma_head = 0, dma_tail = 0;
+static byte_ring rx_ring;
+
+// TX ring: the writer task advances the head, the TX complete interrupt the tail
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 2048
+#endif
+#define UART_TX_TIMEOUT_MS 100
+
+static uint8_t tx_buffer[UART_TX_BUFFER_SIZE];
+static byte_ring tx_ring;
+static volatile uint16_t tx_in_flight = 0;   // length of the chunk being sent by the DMA
+static TaskHandle_t volatile tx_task = NULL; // writer waiting for free space
+
+static transport_stats stats;
+
+// Baud rate negotiation, run by cubemx_transport_open at the rate set by MX_USARTx_UART_Init before the XRCE
+// session starts (tools/microros_baud.py is the host side):
+//   rover: "$BAUD?921600,2000000,3000000\n"  rates this UART can do, offered up to UART_BAUD_OFFERS times
+//   host:  "$BAUD=<rate>\n"                   one of the offered rates
+//   rover: "$BAUD OK\n", then both sides switch
+//   host:  "$BAUD!\n" at the new rate        rover: "$BAUD!\n" back
+// Without the confirmation both sides fall back to the default rate.
+// A plain micro-ROS agent drops these lines since they carry no XRCE framing flag, the link then stays at the default rate.
+// The transport is reopened for every agent ping and session while the host keeps the agreed rate, so the
+// negotiation runs once per physical link. After nothing was received for UART_LINK_TIMEOUT_MS the opens alternate
+// between the agreed rate, for an agent started late that will never answer an offer again, and a new offer at the
+// default rate, for a restarted host.
+#define UART_BAUD_OFFERS 3
+#define UART_BAUD_REPLY_MS 100
+#define UART_BAUD_CONFIRM_MS 500
+#define UART_LINK_TIMEOUT_MS 2000
+
+static const uint32_t uart_rates[] = {921600, 2000000, 3000000};
+static uint32_t default_baud = 0;
+static uint32_t link_baud = 0;           // rate agreed with the host, 0 before the first agreement
+static bool link_retry_agreed = false;   // this link timeout open tries link_baud, the next one offers again
+static bool volatile link_heard = false;
+static TickType_t volatile link_alive;   // last time data arrived
+
+static UART_HandleTypeDef * rx_uart = NULL;
+// Task blocked in cubemx_transport_read, woken by a notification from the UART callbacks
+static TaskHandle_t volatile rx_task = NULL;
+
+static void start_reception(UART_HandleTypeDef * uart){
+    byte_ring_init(&rx_ring, dma_buffer, UART_DMA_BUFFER_SIZE);
+    // Circular DMA: the RX event fires on half transfer, transfer complete and IDLE line without stopping the reception
+    HAL_UARTEx_ReceiveToIdle_DMA(uart, dma_buffer, UART_DMA_BUFFER_SIZE);
+}
+
+// Start the DMA on the next contiguous part of the TX ring, called with interrupts masked or from the TX complete interrupt
+static void start_transmit(UART_HandleTypeDef * uart){
+    uint8_t * chunk;
+    uint32_t pending = byte_ring_linear(&tx_ring, &chunk);
+
+    if (tx_in_flight != 0 || pending == 0){
+        return;
+    }
+
+    if (HAL_UART_Transmit_DMA(uart, chunk, pending) == HAL_OK){
+        tx_in_flight = pending;
+    }
+}
+
+static uint32_t uart_clock(UART_HandleTypeDef * uart){
+    return (uart->Instance == USART1 || uart->Instance == USART6) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+}
+
+// Reprogram the UART, oversampling by 8 above clock/16 (up to 5.25 Mbaud from the 42 MHz APB1), and restart the reception
+static bool uart_set_baud(UART_HandleTypeDef * uart, uint32_t baud){
+    uint32_t clock = uart_clock(uart);
+
+    if (baud > clock / 8){
+        return false;
+    }
+
+    HAL_UART_Abort(uart);
+    uart->Init.BaudRate = baud;
+    uart->Init.OverSampling = (baud > clock / 16) ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+    bool ok = (HAL_UART_Init(uart) == HAL_OK);
+    start_reception(uart);
+    return ok;
+}
+
+static size_t ring_read(UART_HandleTypeDef * uart, uint8_t* buf, size_t len, int timeout);
+
+// Read one '\n' terminated line, false on timeout
+static bool read_line(UART_HandleTypeDef * uart, char * line, size_t size, uint32_t timeout_ms){
+    TickType_t start = xTaskGetTickCount();
+    size_t n = 0;
+
+    while (xTaskGetTickCount() - start < pdMS_TO_TICKS(timeout_ms)){
+        uint8_t c;
+        if (ring_read(uart, &c, 1, 10) == 0){
+            continue;
+        }
+        if (c == '\n'){
+            line[n] = '\0';
+            return true;
+        }
+        if (n < size - 1){
+            line[n++] = c;
+        }
+    }
+    return false;
+}
+
+// Returns the agreed rate, 0 when the host did not confirm one and the UART is back at the default rate
+static uint32_t negotiate_baud(UART_HandleTypeDef * uart){
+    char offer[64] = "$BAUD?";
+    char line[32];
+    uint32_t clock = uart_clock(uart);
+
+    for (size_t i = 0; i < sizeof(uart_rates) / sizeof(uart_rates[0]); i++){
+        if (uart_rates[i] <= clock / 8){
+            size_t n = strlen(offer);
+            snprintf(offer + n, sizeof(offer) - n, "%s%lu", (offer[n - 1] == '?') ? "" : ",", (unsigned long)uart_rates[i]);
+        }
+    }
+    strcat(offer, "\n");
+
+    for (int attempt = 0; attempt < UART_BAUD_OFFERS; attempt++){
+        HAL_UART_Transmit(uart, (uint8_t *)offer, strlen(offer), UART_BAUD_REPLY_MS);
+        if (!read_line(uart, line, sizeof(line), UART_BAUD_REPLY_MS) || strncmp(line, "$BAUD=", 6) != 0){
+            continue;
+        }
+
+        uint32_t baud = strtoul(line + 6, NULL, 10);
+        bool offered = false;
+        for (size_t i = 0; i < sizeof(uart_rates) / sizeof(uart_rates[0]); i++){
+            offered |= (uart_rates[i] == baud) && (baud <= clock / 8);
+        }
+        if (!offered){
+            continue;
+        }
+
+        HAL_UART_Transmit(uart, (uint8_t *)"$BAUD OK\n", 9, UART_BAUD_REPLY_MS);
+        if (uart_set_baud(uart, baud) &&
+                read_line(uart, line, sizeof(line), UART_BAUD_CONFIRM_MS) && strcmp(line, "$BAUD!") == 0){
+            HAL_UART_Transmit(uart, (uint8_t *)"$BAUD!\n", 7, UART_BAUD_REPLY_MS);
+            return baud;
+        }
+
+        // no confirmation at the new rate, the host falls back as well
+        uart_set_baud(uart, default_baud);
+        return 0;
+    }
+    return 0;
+}
+
+static void uart_use_baud(UART_HandleTypeDef * uart, uint32_t baud){
+    if (uart->Init.BaudRate != baud){
+        uart_set_baud(uart, baud);
+    }else{
+        start_reception(uart);
+    }
+}
 
 bool cubemx_transport_open(struct uxrCustomTransport * transport){
     UART_HandleTypeDef * uart = (UART_HandleTypeDef*) transport->args;
-    HAL_UART_Receive_DMA(uart, dma_buffer, UART_DMA_BUFFER_SIZE);
+    rx_uart = uart;
+    byte_ring_init(&tx_ring, tx_buffer, UART_TX_BUFFER_SIZE);
+    tx_in_flight = 0;
+
+    if (default_baud == 0){
+        default_baud = uart->Init.BaudRate;
+    }
+
+    // keep the current rate across reopens while the host answers
+    if (link_heard && xTaskGetTickCount() - link_alive < pdMS_TO_TICKS(UART_LINK_TIMEOUT_MS)){
+        start_reception(uart);
+        return true;
+    }
+
+    // first open or link timeout. An agent exec'd by microros_baud.py stays at the agreed rate however late it
+    // starts, while a restarted host listens at the default rate: alternate between the two
+    link_retry_agreed = !link_retry_agreed;
+    if (link_baud != 0 && link_retry_agreed){
+        uart_use_baud(uart, link_baud);
+        return true;
+    }
+
+    uart_use_baud(uart, default_baud);
+    uint32_t baud = negotiate_baud(uart);
+    if (baud != 0){
+        link_baud = baud;
+        link_alive = xTaskGetTickCount();
+        link_heard = true;
+        // the next link timeout tries the new rate first
+        link_retry_agreed = false;
+    }
     return true;
 }
 
+// Let the queued frames (e.g. the session delete) go out before stopping the DMA, for at most UART_TX_TIMEOUT_MS
 bool cubemx_transport_close(struct uxrCustomTransport * transport){
     UART_HandleTypeDef * uart = (UART_HandleTypeDef*) transport->args;
+    TickType_t start = xTaskGetTickCount();
+
+    // the chunk in flight stays in the ring until its TX complete
+    tx_task = xTaskGetCurrentTaskHandle();
+    while (byte_ring_used(&tx_ring) != 0){
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= pdMS_TO_TICKS(UART_TX_TIMEOUT_MS)){
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UART_TX_TIMEOUT_MS) - elapsed);
+    }
+
+    rx_uart = NULL;
     HAL_UART_DMAStop(uart);
+    tx_in_flight = 0;
     return true;
 }
 
-size_t cubemx_transport_write(struct uxrCustomTransport* transport, uint8_t * buf, size_t len, uint8_t * err){
+// Advance the RX ring head to the current DMA position, called with interrupts masked or from the UART interrupt.
+// NDTR is sampled rather than taking the HAL event position, which is fixed for the half transfer event
+// and could then be behind a position the reader already saw.
+static void update_written(UART_HandleTypeDef * uart){
+    byte_ring_dma_update(&rx_ring, UART_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(uart->hdmarx));
+}
+
+// Called from HAL_UARTEx_RxEventCallback (interrupt context)
+void cubemx_transport_rx_event(UART_HandleTypeDef * uart){
+    BaseType_t woken = pdFALSE;
+
+    if (uart != rx_uart){
+        return;
+    }
+
+    update_written(uart);
+    if (rx_task == NULL){
+        return;
+    }
+
+    vTaskNotifyGiveFromISR(rx_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Called from HAL_UART_TxCpltCallback (interrupt context): release the chunk just sent and chain the next one
+void cubemx_transport_tx_complete(UART_HandleTypeDef * uart){
+    BaseType_t woken = pdFALSE;
+
+    if (uart != rx_uart){
+        return;
+    }
+
+    byte_ring_skip(&tx_ring, tx_in_flight);
+    tx_in_flight = 0;
+    start_transmit(uart);
+
+    if (tx_task != NULL){
+        vTaskNotifyGiveFromISR(tx_task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+// Called from HAL_UART_ErrorCallback (interrupt context).
+// An overrun or DMA error aborts the reception, restart it. A TX DMA error drops the chunk in flight.
+void cubemx_transport_error(UART_HandleTypeDef * uart){
+    if (uart != rx_uart){
+        return;
+    }
+
+    uint32_t error = uart->ErrorCode;
+    if (error & HAL_UART_ERROR_FE) stats.framing_errors++;
+    if (error & HAL_UART_ERROR_NE) stats.noise_errors++;
+    if (error & HAL_UART_ERROR_PE) stats.parity_errors++;
+    if (error & HAL_UART_ERROR_ORE) stats.uart_overruns++;
+    if (error & HAL_UART_ERROR_DMA) stats.dma_errors++;
+
+    if (uart->RxState == HAL_UART_STATE_READY){
+        start_reception(uart);
+        cubemx_transport_rx_event(uart);
+    }
+
+    if (tx_in_flight != 0 && uart->gState == HAL_UART_STATE_READY){
+        cubemx_transport_tx_complete(uart);
+    }
+}
+
+// Copy into the TX ring and return, the DMA drains it in the background.
+// When the ring is full, wait up to UART_TX_TIMEOUT_MS for room; a partial count tells the caller to retry the rest.
+size_t cubemx_transport_write(struct uxrCustomTransport* transport, const uint8_t * buf, size_t len, uint8_t * err){
     UART_HandleTypeDef * uart = (UART_HandleTypeDef*) transport->args;
 
-    HAL_StatusTypeDef ret;
-    if (uart->gState == HAL_UART_STATE_READY){
-        ret = HAL_UART_Transmit_DMA(uart, buf, len);
-        while (ret == HAL_OK && uart->gState != HAL_UART_STATE_READY){
-            osDelay(1);
+    TickType_t start = xTaskGetTickCount();
+
+    tx_task = xTaskGetCurrentTaskHandle();
+    while (byte_ring_free(&tx_ring) == 0){
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= pdMS_TO_TICKS(UART_TX_TIMEOUT_MS)){
+            transport_stats_write(&stats, 0, UART_TX_BUFFER_SIZE);
+            *err = 1;
+            return 0;
         }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UART_TX_TIMEOUT_MS) - elapsed);
+    }
 
-        return (ret == HAL_OK) ? len : 0;
-    }else{
+    // only the interrupt moves the tail, which can only make more room
+    len = byte_ring_write(&tx_ring, buf, len);
+
+    uint32_t primask = critical_enter();
+    start_transmit(uart);
+    uint32_t queued = byte_ring_used(&tx_ring);
+    critical_exit(primask);
+
+    transport_stats_write(&stats, len, queued);
+    return len;
+}
+
+static size_t ring_read(UART_HandleTypeDef * uart, uint8_t* buf, size_t len, int timeout){
+    TickType_t start = xTaskGetTickCount();
+    TickType_t wait = pdMS_TO_TICKS(timeout);
+    uint32_t started = transport_stats_now();
+    uint32_t pending;
+
+    rx_task = xTaskGetCurrentTaskHandle();
+    for (;;)
+    {
+        uint32_t primask = critical_enter();
+        update_written(uart);
+        critical_exit(primask);
+        pending = byte_ring_used(&rx_ring);
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (pending != 0 || elapsed >= wait){
+            break;
+        }
+
+        // A notification given since the last check is kept, so no event can be missed here
+        ulTaskNotifyTake(pdTRUE, wait - elapsed);
+    }
+
+    if (pending != 0){
+        link_alive = xTaskGetTickCount();
+        link_heard = true;
+    }
+
+    if (pending > UART_DMA_BUFFER_SIZE){
+        // Part of the pending data has been overwritten: drop it all, the XRCE framing resynchronises on the next frame
+        stats.rx_overruns++;
+        byte_ring_skip(&rx_ring, pending);
+        transport_stats_read(&stats, started, 0);
         return 0;
     }
+
+    size_t wrote = byte_ring_read(&rx_ring, buf, len);
+
+    transport_stats_read(&stats, started, wrote);
+    return wrote;
 }
 
 size_t cubemx_transport_read(struct uxrCustomTransport* transport, uint8_t* buf, size_t len, int timeout, uint8_t* err){
     UART_HandleTypeDef * uart = (UART_HandleTypeDef*) transport->args;
 
-    int ms_used = 0;
-    do
-    {
-        __disable_irq();
-        dma_tail = UART_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(uart->hdmarx);
-        __enable_irq();
-        ms_used++;
-        osDelay(portTICK_RATE_MS);
-    } while (dma_head == dma_tail && ms_used < timeout);
-    
-    size_t wrote = 0;
-    while ((dma_head != dma_tail) && (wrote < len)){
-        buf[wrote] = dma_buffer[dma_head];
-        dma_head = (dma_head + 1) % UART_DMA_BUFFER_SIZE;
-        wrote++;
-    }
-    
-    return wrote;
+    return ring_read(uart, buf, len, timeout);
+}
+
+const transport_stats * cubemx_transport_get_stats(void){
+    return &stats;
+}
+
+void cubemx_transport_reset_stats(void){
+    memset(&stats, 0, sizeof(stats));
 }
 
 #endif //RMW_UXRCE_TRANSPORT_CUSTOM
\ No newline at end of file
@@ -0,0 +1,52 @@
+// Statistics shared by the micro-ROS transports. Latencies are measured with the DWT cycle counter.
+
+#include "microros_transport.h"
+
+static uint32_t cycles_per_us = 0;
+
+// Cycle counter value used as the start of a measurement, enables the counter on first use
+uint32_t transport_stats_now(void){
+    if (cycles_per_us == 0){
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        cycles_per_us = SystemCoreClock / 1000000;
+    }
+    return DWT->CYCCNT;
+}
+
+// Account for a read that started at start (transport_stats_now) and returned len bytes
+void transport_stats_read(transport_stats * stats, uint32_t start, size_t len){
+    if (len == 0){
+        stats->read_timeouts++;
+        return;
+    }
+
+    uint32_t latency = (DWT->CYCCNT - start) / cycles_per_us;
+
+    if (stats->reads == 0 || latency < stats->read_latency_min_us){
+        stats->read_latency_min_us = latency;
+    }
+    if (latency > stats->read_latency_max_us){
+        stats->read_latency_max_us = latency;
+    }
+    if (stats->reads == 0){
+        stats->read_latency_avg_us = latency;
+    }else{
+        stats->read_latency_avg_us += ((int32_t)latency - (int32_t)stats->read_latency_avg_us) / 16;
+    }
+
+    stats->reads++;
+    stats->bytes_in += len;
+}
+
+// Account for a write of len bytes, queued is what remains to be sent afterwards
+void transport_stats_write(transport_stats * stats, size_t len, uint32_t queued){
+    if (len == 0){
+        stats->tx_rejects++;
+    }
+    stats->bytes_out += len;
+    stats->tx_queue_depth = queued;
+    if (queued > stats->tx_queue_max){
+        stats->tx_queue_max = queued;
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * nrf24_hal.c
+ *
+ *  Blocking HAL SPI transfers. A 32 byte payload takes well under a millisecond on the bus, the timeout
+ *  only bounds a stuck peripheral.
+ */
+
+#include "nrf24_hal.h"
+
+#define NRF24_HAL_TIMEOUT_MS 100
+
+static void nrf24_hal_transfer(void *ctx, const uint8_t *tx, uint8_t *rx, uint16_t size)
+{
+	nrf24_hal_bus *bus = ctx;
+
+	if (tx == NULL)
+	{
+		HAL_SPI_Receive(bus->hspi, rx, size, NRF24_HAL_TIMEOUT_MS);
+	}
+	else if (rx == NULL)
+	{
+		HAL_SPI_Transmit(bus->hspi, (uint8_t *)tx, size, NRF24_HAL_TIMEOUT_MS);
+	}
+	else
+	{
+		HAL_SPI_TransmitReceive(bus->hspi, (uint8_t *)tx, rx, size, NRF24_HAL_TIMEOUT_MS);
+	}
+}
+
+static void nrf24_hal_csn(void *ctx, uint8_t level)
+{
+	nrf24_hal_bus *bus = ctx;
+
+	HAL_GPIO_WritePin(bus->csn_port, bus->csn_pin, level ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+static void nrf24_hal_ce(void *ctx, uint8_t level)
+{
+	nrf24_hal_bus *bus = ctx;
+
+	HAL_GPIO_WritePin(bus->ce_port, bus->ce_pin, level ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+static void nrf24_hal_delay_ms(void *ctx, uint32_t ms)
+{
+	(void)ctx;
+	HAL_Delay(ms);
+}
+
+const nrf24_spi_ops nrf24_hal_ops = {
+	.transfer = nrf24_hal_transfer,
+	.csn = nrf24_hal_csn,
+	.ce = nrf24_hal_ce,
+	.delay_ms = nrf24_hal_delay_ms,
+};
@@ -16,6 +16,47 @@ void set_pid(pid_instance *pid, float p, float i, float d)
 	pid ->d_gain = d;
 }
 
+/*	@brief read the tunable parameters of a pid
+ * 	@param pid: pid instance
+ * 	@param config: gains and limits
+ * 	@retval: none
+ * */
+void get_pid_config(const pid_instance *pid, pid_config *config)
+{
+	config->p_gain = pid->p_gain;
+	config->i_gain = pid->i_gain;
+	config->d_gain = pid->d_gain;
+	config->integral_max = pid->integral_max;
+	config->pid_max = pid->pid_max;
+}
+
+/*	@brief change gains and limits of a running pid without a bump in its output
+ * 	The error integral is rescaled so that the integral term keeps its value with the new i gain.
+ * 	@param pid: pid instance
+ * 	@param config: gains and limits
+ * 	@retval: none
+ * */
+void configure_pid(pid_instance *pid, const pid_config *config)
+{
+	float integral_term = pid->i_gain * pid->error_integral;
+
+	set_pid(pid, config->p_gain, config->i_gain, config->d_gain);
+	pid->integral_max = config->integral_max;
+	pid->pid_max = config->pid_max;
+
+	// bumpless transfer
+	if (config->i_gain != 0)
+	{
+		pid->error_integral = integral_term / config->i_gain;
+		if (pid->error_integral > pid->integral_max) {
+			pid->error_integral = pid->integral_max;
+		}
+		if (pid->error_integral < -pid->integral_max) {
+			pid->error_integral = -pid->integral_max;
+		}
+	}
+}
+
 /*	@brief resetting the pid
  * 	@param pid: pid instance
  * 	@retval: none
@@ -75,6 +116,9 @@ pid_typedef apply_pid(pid_instance *pid, float input_error)
 
 
 #define TABLE_SIZE (sizeof(velocity_pwm_table) / sizeof(Velocity_PWM_Map))
+
+// Scale of the table duty, tuned at run time
+static volatile float pwm_table_gain = 1.0f;
 // Predefined Velocity-to-PWM Mapping Table
 const Velocity_PWM_Map velocity_pwm_table[] = {
     { -68.0, -100.0 }, { -60.0, -90.0 }, { -52.0, -80.0 },
@@ -105,15 +149,32 @@ float get_pwm_from_velocity(float desired_velocity) {
             float pwm2 = velocity_pwm_table[i + 1].pwm_duty;
 
             // Linear Interpolation
-            return pwm1 + ((desired_velocity - v1) / (v2 - v1)) * (pwm2 - pwm1);
+            return pwm_table_gain * (pwm1 + ((desired_velocity - v1) / (v2 - v1)) * (pwm2 - pwm1));
         }
     }
 
     // Clamp PWM if velocity is outside the range
     if (desired_velocity < velocity_pwm_table[0].velocity)
-        return velocity_pwm_table[0].pwm_duty;
+        return pwm_table_gain * velocity_pwm_table[0].pwm_duty;
     if (desired_velocity > velocity_pwm_table[TABLE_SIZE - 1].velocity)
-        return velocity_pwm_table[TABLE_SIZE - 1].pwm_duty;
+        return pwm_table_gain * velocity_pwm_table[TABLE_SIZE - 1].pwm_duty;
 
     return 0.0; // Default case (should not occur)
 }
+
+/**
+ * @brief Scale the duty given by the velocity table (feedforward gain).
+ * @param gain: 1 for the table as measured.
+ * @return none
+ */
+void set_pwm_table_gain(float gain) {
+    pwm_table_gain = gain;
+}
+
+/**
+ * @brief Feedforward gain in use.
+ * @return gain
+ */
+float get_pwm_table_gain(void) {
+    return pwm_table_gain;
+}
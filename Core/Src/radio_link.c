@@ -0,0 +1,125 @@
+/*
+ * radio_link.c
+ *
+ *  Demultiplexes the NRF24 RX FIFO by pipe number and hands the commands of each source
+ *  to the application, which arbitrates between the sources.
+ */
+
+#include "radio_link.h"
+#include <stddef.h>
+
+static nrf24_inst *link_radio;
+static radio_source *link_sources;
+static uint8_t link_count;
+
+static radio_source *find_source(uint8_t pipe)
+{
+	for (uint8_t i = 0; i < link_count; i++)
+	{
+		if (link_sources[i].pipe == pipe)
+		{
+			return &link_sources[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*	@brief put the radio in receive mode and open one pipe per source
+ * 	@param radio: radio instance, its address is the pipe 1 address and pipes 2 to 5 share its 4 MSB
+ * 	@param sources: source table, kept by the link
+ * 	@param count: number of entries in the table
+ * 	@retval: none
+ * */
+void radio_link_init(nrf24_inst *radio, radio_source *sources, uint8_t count)
+{
+	link_radio = radio;
+	link_sources = sources;
+	link_count = count;
+
+	NRF24_RxMode(radio);
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		radio_decoder_reset(&sources[i].decoder);
+		NRF24_OpenRxPipe(link_radio, sources[i].pipe, sources[i].address, sources[i].width);
+	}
+
+	NRF24_EnableAckPayload(link_radio);
+}
+
+/*	@brief read everything waiting in the RX FIFO
+ * 	Each payload is attributed to its source from the pipe number, binary frames are validated
+ * 	with the source decoder.
+ * 	@param handler: called for every command to apply
+ * 	@param now_ms: local time in ms
+ * 	@retval: bit n is set when pipe n received something
+ * */
+uint8_t radio_link_poll(radio_command_handler handler, uint32_t now_ms)
+{
+	uint8_t received = 0;
+	uint8_t data[32];
+	uint8_t pipe;
+
+	while ((pipe = NRF24_RxPipe(link_radio)) < RADIO_PIPES)
+	{
+		radio_source *source = find_source(pipe);
+		uint8_t len;
+
+		if ((source != NULL) && (source->width != 0))
+		{
+			len = NRF24_ReceiveWidth(link_radio, data, source->width);
+		}
+		else
+		{
+			len = NRF24_ReceiveDynamic(link_radio, data);
+		}
+
+		if ((source == NULL) || (len == 0))
+		{
+			continue;
+		}
+
+		received |= (1<<pipe);
+		source->stats.packets++;
+		source->stats.bytes += len;
+
+		const radio_frame_header *header = NULL;
+		const uint8_t *payload = data;
+
+		if (data[0] == RADIO_FRAME_MAGIC)
+		{
+			if (radio_decode(&source->decoder, data, len, now_ms, &header, &payload) != radio_ok)
+			{
+				source->stats.rejected++;
+				continue;
+			}
+		}
+		else if (data[0] == '\0')
+		{
+			continue;
+		}
+
+		source->stats.last_command_ms = now_ms;
+		handler(source, header, payload, len);
+	}
+
+	return received;
+}
+
+/*	@brief load the telemetry into the ACK payload of the sources that asked for it
+ * 	@param received: pipes that just received, as returned by radio_link_poll
+ * 	@param data: telemetry
+ * 	@param len: telemetry size
+ * 	@retval: none
+ * */
+void radio_link_ack(uint8_t received, uint8_t *data, uint8_t len)
+{
+	for (uint8_t i = 0; i < link_count; i++)
+	{
+		if (link_sources[i].ack_telemetry && (received & (1<<link_sources[i].pipe)))
+		{
+			NRF24_WriteAckPayload(link_radio, link_sources[i].pipe, data, len);
+		}
+	}
+}
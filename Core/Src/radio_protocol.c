@@ -0,0 +1,176 @@
+/*
+ * radio_protocol.c
+ *
+ *  Validation of the binary command frames received over the NRF24 link.
+ *  The decoder does not copy anything, the header and payload pointers point into the receive buffer.
+ */
+
+#include "radio_protocol.h"
+#include <stddef.h>
+
+// CRC-16/CCITT-FALSE nibble table (polynomial 0x1021)
+static const uint16_t crc16_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/*	@brief compute the CRC-16/CCITT-FALSE of a buffer
+ * 	@param data: bytes to check
+ * 	@param len: number of bytes
+ * 	@retval: crc value
+ * */
+uint16_t radio_crc16(const uint8_t *data, uint8_t len)
+{
+	uint16_t crc = 0xFFFF;
+
+	for (uint8_t i = 0; i < len; i++)
+	{
+		crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (data[i] >> 4)];
+		crc = (crc << 4) ^ crc16_table[(crc >> 12) ^ (data[i] & 0x0F)];
+	}
+
+	return crc;
+}
+
+/*	@brief forget the sequence history, the next valid frame is accepted whatever its number
+ * 	@param dec: decoder instance
+ * 	@retval: none
+ * */
+void radio_decoder_reset(radio_decoder *dec)
+{
+	dec->synced = 0;
+	dec->last_seq = 0;
+	dec->last_rx_ms = 0;
+	dec->min_offset_ms = 0;
+	dec->window_min_ms = 0;
+	dec->previous_min_ms = 0;
+	dec->window_start_ms = 0;
+}
+
+/* keep the lowest offset over the current and the previous window: when the sender clock runs slower
+ * than ours the offsets keep growing, and an all-time minimum would end up rejecting every frame */
+static void track_offset(radio_decoder *dec, int32_t offset, uint32_t now_ms)
+{
+	if (now_ms - dec->window_start_ms >= RADIO_OFFSET_WINDOW_MS)
+	{
+		dec->previous_min_ms = dec->window_min_ms;
+		dec->window_min_ms = offset;
+		dec->window_start_ms = now_ms;
+	}
+	else if (offset < dec->window_min_ms)
+	{
+		dec->window_min_ms = offset;
+	}
+
+	dec->min_offset_ms = (dec->window_min_ms < dec->previous_min_ms) ? dec->window_min_ms : dec->previous_min_ms;
+}
+
+static int8_t payload_length(uint8_t type)
+{
+	switch (type)
+	{
+		case RADIO_FRAME_STOP:
+			return 0;
+		case RADIO_FRAME_TWIST:
+			return sizeof(radio_twist_payload);
+		case RADIO_FRAME_WHEELS:
+			return sizeof(radio_wheels_payload);
+		default:
+			return -1;
+	}
+}
+
+/*	@brief validate a received frame
+ * 	Checks the length, magic, version and CRC, then discards duplicated, out of order and delayed frames.
+ * 	The sender clock is never compared with ours directly: the lowest (local - sender) offset of the
+ * 	last RADIO_OFFSET_WINDOW_MS or so is taken as zero latency and a frame arriving more than
+ * 	RADIO_STALE_MS later than that is stale. The window lets the reference follow a drifting sender clock.
+ * 	@param dec: decoder instance
+ * 	@param buf: received payload
+ * 	@param len: number of bytes in buf
+ * 	@param now_ms: local time in ms
+ * 	@param header: set to the frame header inside buf when radio_ok is returned
+ * 	@param payload: set to the frame payload inside buf when radio_ok is returned
+ * 	@retval: radio_ok if the frame has to be applied
+ * */
+radio_status radio_decode(radio_decoder *dec, const uint8_t *buf, uint8_t len, uint32_t now_ms,
+		const radio_frame_header **header, const uint8_t **payload)
+{
+	const radio_frame_header *hdr = (const radio_frame_header *)buf;
+	radio_status status = radio_ok;
+
+	if (len < sizeof(radio_frame_header) + 2)
+	{
+		status = radio_bad_length;
+	}
+	else if (hdr->magic != RADIO_FRAME_MAGIC)
+	{
+		status = radio_bad_magic;
+	}
+	else if (hdr->version != RADIO_FRAME_VERSION)
+	{
+		status = radio_bad_version;
+	}
+	else
+	{
+		int8_t body = payload_length(hdr->type);
+		uint8_t frame_len = sizeof(radio_frame_header) + body;
+
+		if ((body < 0) || (len < frame_len + 2))
+		{
+			status = radio_bad_length;
+		}
+		else if (radio_crc16(buf, frame_len) != (uint16_t)(buf[frame_len] | (buf[frame_len + 1] << 8)))
+		{
+			status = radio_bad_crc;
+		}
+	}
+
+	if (status != radio_ok)
+	{
+		dec->rejected++;
+		return status;
+	}
+
+	int32_t offset = (int32_t)(now_ms - hdr->timestamp_ms);
+
+	if (!dec->synced || (now_ms - dec->last_rx_ms > RADIO_RESYNC_MS))
+	{
+		// first frame, or the sender may have restarted: take whatever sequence it is at
+		dec->synced = 1;
+		dec->min_offset_ms = offset;
+		dec->window_min_ms = offset;
+		dec->previous_min_ms = offset;
+		dec->window_start_ms = now_ms;
+	}
+	else
+	{
+		int16_t seq_diff = (int16_t)(hdr->seq - dec->last_seq);
+
+		track_offset(dec, offset, now_ms);
+
+		if (seq_diff == 0)
+		{
+			status = radio_duplicate;
+		}
+		else if ((seq_diff < 0) || (offset - dec->min_offset_ms > RADIO_STALE_MS))
+		{
+			status = radio_stale;
+		}
+	}
+
+	if (status != radio_ok)
+	{
+		dec->rejected++;
+		return status;
+	}
+
+	dec->last_seq = hdr->seq;
+	dec->last_rx_ms = now_ms;
+	dec->accepted++;
+
+	*header = hdr;
+	*payload = buf + sizeof(radio_frame_header);
+
+	return radio_ok;
+}
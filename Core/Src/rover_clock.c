@@ -0,0 +1,123 @@
+/*
+ * rover_clock.c
+ *
+ *  The 32-bit cycle counter wraps every 2^32 / SystemCoreClock seconds (25 s at 168 MHz), it is
+ *  extended by accumulating its increments. rover_clock_update has to run at least once per wrap,
+ *  it is called from the 2 kHz control timer (TIM5).
+ */
+
+#include "rover_clock.h"
+#include "main.h"
+#include "critical.h"
+
+#define NANOSECONDS_PER_SECOND 1000000000ULL
+
+static uint32_t last_cycles;
+static uint64_t cycles;
+static rover_clock_sync_state sync_state;
+
+/*	@brief start the cycle counter
+ * 	@retval: none
+ * */
+void rover_clock_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	last_cycles = DWT->CYCCNT;
+}
+
+/* extend the counter, interrupts masked */
+static uint64_t extend(void)
+{
+	uint32_t now = DWT->CYCCNT;
+
+	cycles += (uint32_t)(now - last_cycles);
+	last_cycles = now;
+	return cycles;
+}
+
+/*	@brief account for the counter increments, at least once per counter wrap
+ * 	@retval: none
+ * */
+void rover_clock_update(void)
+{
+	uint32_t primask = critical_enter();
+
+	extend();
+
+	critical_exit(primask);
+}
+
+/*	@brief local time
+ * 	@retval: ns since rover_clock_init
+ * */
+uint64_t rover_clock_local_ns(void)
+{
+	uint32_t primask = critical_enter();
+
+	uint64_t count = extend();
+
+	critical_exit(primask);
+
+	uint32_t hz = SystemCoreClock;
+	return (count / hz) * NANOSECONDS_PER_SECOND + (count % hz) * NANOSECONDS_PER_SECOND / hz;
+}
+
+/*	@brief discipline the clock with a synchronisation result
+ * 	@param agent_ns: agent time
+ * 	@param local_ns: local time at the same instant
+ * 	@retval: none
+ * */
+void rover_clock_sync(int64_t agent_ns, uint64_t local_ns)
+{
+	int64_t offset = agent_ns - (int64_t)local_ns;
+	rover_clock_sync_state state = sync_state;
+
+	if (state.syncs != 0 && local_ns - state.sync_local_ns >= NANOSECONDS_PER_SECOND)
+	{
+		float measured = (float)(offset - state.offset_ns) / (float)(local_ns - state.sync_local_ns);
+
+		state.drift = (state.syncs == 1) ? measured :
+				state.drift + (measured - state.drift) / ROVER_CLOCK_DRIFT_FILTER;
+	}
+	state.offset_ns = offset;
+	state.sync_local_ns = local_ns;
+	state.syncs++;
+
+	uint32_t primask = critical_enter();
+
+	sync_state = state;
+
+	critical_exit(primask);
+}
+
+/*	@brief convert a local time to agent time
+ * 	@param local_ns: local time
+ * 	@retval: agent time, local_ns as long as the clock never synchronised
+ * */
+int64_t rover_clock_to_agent_ns(uint64_t local_ns)
+{
+	rover_clock_sync_state state;
+
+	rover_clock_get_sync(&state);
+	if (state.syncs == 0)
+	{
+		return local_ns;
+	}
+
+	int64_t elapsed = (int64_t)(local_ns - state.sync_local_ns);
+	return (int64_t)local_ns + state.offset_ns + (int64_t)(state.drift * (float)elapsed);
+}
+
+/*	@brief copy of the synchronisation state
+ * 	@param state: destination
+ * 	@retval: none
+ * */
+void rover_clock_get_sync(rover_clock_sync_state *state)
+{
+	uint32_t primask = critical_enter();
+
+	*state = sync_state;
+
+	critical_exit(primask);
+}
@@ -0,0 +1,93 @@
+/*
+ * tlog.c
+ *
+ *  Ring of framed log records. Producers (tasks or interrupts) hold a critical section only for the
+ *  copy of a record of at most 20 bytes, the consumer copies out whole records.
+ */
+
+#include "tlog.h"
+#include "main.h"
+#include "critical.h"
+
+#define TLOG_HEADER_SIZE 4
+#define TLOG_MASK (TLOG_BUFFER_SIZE - 1)
+
+static uint8_t tlog_buffer[TLOG_BUFFER_SIZE];
+static volatile uint32_t tlog_head = 0;  /* free running, advanced by the producers */
+static volatile uint32_t tlog_tail = 0;  /* free running, advanced by tlog_drain */
+static tlog_stats stats;
+
+static void tlog_put(uint32_t pos, const uint8_t *data, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++)
+	{
+		tlog_buffer[(pos + i) & TLOG_MASK] = data[i];
+	}
+}
+
+/*	@brief queue one record, called through the TLOG macro
+ * 	@param id: offset of the format string in .tlog_fmt
+ * 	@param nargs: number of arguments
+ * 	@param args: arguments, already converted to 32 bits
+ * 	@retval: none
+ * */
+void tlog_record(uint16_t id, uint8_t nargs, const uint32_t *args)
+{
+	uint8_t header[TLOG_HEADER_SIZE] = {TLOG_SYNC, id & 0xFF, id >> 8, nargs};
+	uint32_t len = TLOG_HEADER_SIZE + nargs * sizeof(uint32_t);
+
+	uint32_t primask = critical_enter();
+
+	if (TLOG_BUFFER_SIZE - (tlog_head - tlog_tail) < len)
+	{
+		stats.dropped++;
+	}
+	else
+	{
+		tlog_put(tlog_head, header, TLOG_HEADER_SIZE);
+		tlog_put(tlog_head + TLOG_HEADER_SIZE, (const uint8_t *)args, len - TLOG_HEADER_SIZE);
+		tlog_head += len;
+		stats.records++;
+	}
+
+	critical_exit(primask);
+}
+
+/*	@brief copy whole records out of the ring, single consumer
+ * 	@param out: destination
+ * 	@param size: room in out
+ * 	@retval: number of bytes copied
+ * */
+uint16_t tlog_drain(uint8_t *out, uint16_t size)
+{
+	uint32_t tail = tlog_tail;
+	uint32_t head = tlog_head;
+	uint16_t copied = 0;
+
+	while (tail != head)
+	{
+		uint32_t len = TLOG_HEADER_SIZE + tlog_buffer[(tail + 3) & TLOG_MASK] * sizeof(uint32_t);
+
+		if (copied + len > size)
+		{
+			break;
+		}
+
+		for (uint32_t i = 0; i < len; i++)
+		{
+			out[copied++] = tlog_buffer[(tail + i) & TLOG_MASK];
+		}
+		tail += len;
+	}
+
+	tlog_tail = tail;
+	return copied;
+}
+
+/*	@brief logger counters
+ * 	@retval: statistics
+ * */
+const tlog_stats *tlog_get_stats(void)
+{
+	return &stats;
+}
@@ -0,0 +1,99 @@
+/*
+ * wheel_batch.c
+ *
+ *  Several producers (the wheel tasks), each push is one critical section, and a single consumer
+ *  that never blocks them.
+ */
+
+#include "wheel_batch.h"
+#include "main.h"
+#include "critical.h"
+
+/*	@brief queue the result of a control step, dropped when the ring is full
+ * 	@param batch: queue
+ * 	@param wheel: wheel 0..3 (a..d)
+ * 	@param sample: state of the wheel after the step
+ * 	@retval: none
+ * */
+void wheel_batch_push(wheel_batch *batch, uint8_t wheel, const wheel_sample *sample)
+{
+	uint32_t primask = critical_enter();
+
+	uint32_t head = batch->head;
+
+	if (head - batch->tail >= WHEEL_BATCH_RING)
+	{
+		batch->dropped++;
+	}
+	else
+	{
+		wheel_record *record = &batch->records[head & (WHEEL_BATCH_RING - 1)];
+
+		record->sample = *sample;
+		record->wheel = wheel;
+		__DMB();
+		batch->head = head + 1;
+	}
+
+	critical_exit(primask);
+}
+
+/*	@brief records waiting
+ * 	@param batch: queue
+ * 	@retval: number of records
+ * */
+uint32_t wheel_batch_pending(const wheel_batch *batch)
+{
+	return batch->head - batch->tail;
+}
+
+/*	@brief check whether a batch should be sent
+ * 	@param batch: queue
+ * 	@param count: send as soon as this many records are waiting
+ * 	@param deadline_ms: send when the oldest record is this old
+ * 	@param now_ns: rover_clock local time
+ * 	@retval: 1 if a batch should be sent
+ * */
+uint8_t wheel_batch_due(const wheel_batch *batch, uint32_t count, uint32_t deadline_ms, uint64_t now_ns)
+{
+	uint32_t pending = wheel_batch_pending(batch);
+
+	if (pending == 0)
+	{
+		return 0;
+	}
+	if (pending >= count)
+	{
+		return 1;
+	}
+
+	const wheel_record *oldest = &batch->records[batch->tail & (WHEEL_BATCH_RING - 1)];
+	return (now_ns - oldest->sample.stamp_ns >= deadline_ms * 1000000ULL);
+}
+
+/*	@brief take the oldest records
+ * 	@param batch: queue
+ * 	@param out: destination
+ * 	@param max: room in out
+ * 	@retval: number of records copied
+ * */
+uint32_t wheel_batch_pop(wheel_batch *batch, wheel_record *out, uint32_t max)
+{
+	uint32_t tail = batch->tail;
+	uint32_t count = batch->head - tail;
+
+	if (count > max)
+	{
+		count = max;
+	}
+	__DMB(); // records up to head are complete
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		out[i] = batch->records[(tail + i) & (WHEEL_BATCH_RING - 1)];
+	}
+
+	__DMB();
+	batch->tail = tail + count;
+	return count;
+}
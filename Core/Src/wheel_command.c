@@ -0,0 +1,61 @@
+/*
+ * wheel_command.c
+ *
+ *  Single producer, any number of consumers. A consumer retries when the producer posted while it
+ *  was copying, which is rare at the command rates involved.
+ */
+
+#include "wheel_command.h"
+#include "main.h"
+
+/*	@brief publish a new command, never blocks
+ * 	@param box: mailbox
+ * 	@param wheel: setpoints a..d in RPM
+ * 	@param now_ms: local time
+ * 	@retval: none
+ * */
+void wheel_mailbox_post(wheel_mailbox *box, const float wheel[WHEEL_COUNT], uint32_t now_ms)
+{
+	uint32_t seq = box->seq + 1;
+	wheel_setpoint *slot = &box->slot[seq & 1];
+
+	for (uint8_t i = 0; i < WHEEL_COUNT; i++)
+	{
+		slot->wheel[i] = wheel[i];
+	}
+	slot->stamp_ms = now_ms;
+	slot->seq = seq;
+
+	__DMB(); // the slot is complete before it is published
+	box->seq = seq;
+}
+
+/*	@brief copy the latest command
+ * 	@param box: mailbox
+ * 	@param out: latest command, seq is 0 if nothing was ever posted
+ * 	@retval: none
+ * */
+void wheel_mailbox_take(wheel_mailbox *box, wheel_setpoint *out)
+{
+	uint32_t seq;
+
+	do
+	{
+		seq = box->seq;
+		__DMB();
+		*out = box->slot[seq & 1];
+		__DMB();
+		// the next post already rewrites this slot before publishing seq + 2, so any post means a retry
+	} while (box->seq != seq);
+}
+
+/*	@brief check the age of a command
+ * 	@param setpoint: command taken from a mailbox
+ * 	@param now_ms: local time
+ * 	@param timeout_ms: maximum age
+ * 	@retval: 1 if the command was posted and is not older than timeout_ms
+ * */
+uint8_t wheel_setpoint_fresh(const wheel_setpoint *setpoint, uint32_t now_ms, uint32_t timeout_ms)
+{
+	return (setpoint->seq != 0) && (now_ms - setpoint->stamp_ms <= timeout_ms);
+}
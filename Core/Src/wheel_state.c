@@ -0,0 +1,55 @@
+/*
+ * wheel_state.c
+ *
+ *  Sequence lock over the four wheel samples. The control tasks are several writers, each update is
+ *  one critical section.
+ */
+
+#include "wheel_state.h"
+#include "main.h"
+#include "critical.h"
+
+/*	@brief store the result of a control step
+ * 	@param state: shared wheel state
+ * 	@param index: wheel 0..3 (a..d)
+ * 	@param sample: state of the wheel after the step
+ * 	@retval: none
+ * */
+void wheel_state_update(wheel_state *state, uint8_t index, const wheel_sample *sample)
+{
+	uint32_t primask = critical_enter();
+
+	state->seq++;
+	__DMB();
+	state->wheel[index] = *sample;
+	__DMB();
+	state->seq++;
+
+	critical_exit(primask);
+}
+
+/*	@brief copy the state of all the wheels
+ * 	@param state: shared wheel state
+ * 	@param out: the four wheel samples
+ * 	@retval: sequence number of the copy, it changes with every update
+ * */
+uint32_t wheel_state_snapshot(wheel_state *state, wheel_sample out[WHEEL_COUNT])
+{
+	uint32_t seq;
+
+	do
+	{
+		while ((seq = state->seq) & 1)
+		{
+			// cannot last: the writers run with the interrupts masked
+		}
+		__DMB();
+		for (uint8_t i = 0; i < WHEEL_COUNT; i++)
+		{
+			out[i] = state->wheel[i];
+		}
+		__DMB();
+	} while (state->seq != seq);
+
+	return seq;
+}
@@ -0,0 +1,91 @@
+/*
+ * wheel_tuning.c
+ *
+ *  The staged settings are copied in a critical section on both sides.
+ */
+
+#include "wheel_tuning.h"
+#include "main.h"
+#include "critical.h"
+
+static float ff_gain_staged;
+static volatile uint8_t ff_gain_pending;
+
+/*	@brief hand new settings to the control task
+ * 	@param tuning: tuning of the wheel
+ * 	@param config: complete settings of the wheel
+ * 	@retval: none
+ * */
+void wheel_tuning_stage(wheel_tuning *tuning, const wheel_tuning_config *config)
+{
+	uint32_t primask = critical_enter();
+
+	tuning->staged = *config;
+	tuning->pending = 1;
+
+	critical_exit(primask);
+}
+
+/*	@brief apply the staged settings, to be called by the control task between two steps
+ * 	@param tuning: tuning of the wheel
+ * 	@param pid: velocity controller of the wheel, changed without a bump in its output
+ * 	@param period_ms: control step period of the task
+ * 	@retval: 1 if new settings were applied
+ * */
+uint8_t wheel_tuning_apply(wheel_tuning *tuning, pid_instance *pid, uint16_t *period_ms)
+{
+	wheel_tuning_config config;
+
+	if (!tuning->pending)
+	{
+		return 0;
+	}
+
+	uint32_t primask = critical_enter();
+
+	config = tuning->staged;
+	tuning->pending = 0;
+
+	critical_exit(primask);
+
+	configure_pid(pid, &config.pid);
+	*period_ms = config.period_ms;
+	return 1;
+}
+
+/*	@brief hand a new feedforward gain to the control task of wheel a
+ * 	@param gain: scale of the velocity to duty table
+ * 	@retval: none
+ * */
+void wheel_tuning_stage_ff_gain(float gain)
+{
+	uint32_t primask = critical_enter();
+
+	ff_gain_staged = gain;
+	ff_gain_pending = 1;
+
+	critical_exit(primask);
+}
+
+/*	@brief apply the staged feedforward gain, to be called by the control task of wheel a between two steps
+ * 	@retval: 1 if a new gain was applied
+ * */
+uint8_t wheel_tuning_apply_ff_gain(void)
+{
+	float gain;
+
+	if (!ff_gain_pending)
+	{
+		return 0;
+	}
+
+	uint32_t primask = critical_enter();
+
+	gain = ff_gain_staged;
+	ff_gain_pending = 0;
+
+	critical_exit(primask);
+
+	set_pwm_table_gain(gain);
+	return 1;
+}
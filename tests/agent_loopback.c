@@ -0,0 +1,111 @@
+/*
+ * agent_loopback.c
+ *
+ *  A Micro XRCE-DDS session through the micro-ROS UART transport with a real agent on the slave
+ *  end of the pty: creates the session, pings the agent and deletes the session.
+ *  usage: agent_loopback <agent executable> [pings, default 100]
+ *  The agent is started as "<agent> serial --dev <pty> -b 115200" and ignores the baud rate offer.
+ */
+
+#include "transport_host.h"
+#include "uart_pty.h"
+#include "task.h"
+#include <uxr/client/client.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+#define AGENT_RATE "115200"
+#define SESSION_KEY 0x524F5652
+#define SESSION_TRIES 10    /* the agent needs a moment to open the pty */
+#define PING_TIMEOUT_MS 100
+
+extern char **environ;
+
+int main(int argc, char **argv)
+{
+	struct uxrCustomTransport transport;
+	uxrSession session;
+	uart_pty pty;
+	pid_t agent;
+	uint32_t pings = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100;
+	uint32_t lost = 0, rtt_max = 0, rtt_sum = 0;
+	bool created = false;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <agent executable> [pings]\n", argv[0]);
+		return 2;
+	}
+
+	UART_HandleTypeDef *uart = uart_pty_open(&pty, 115200);
+	if (uart == NULL)
+	{
+		printf("no pty available\n");
+		return 1;
+	}
+
+	char *agent_argv[] = {argv[1], "serial", "--dev", (char *)uart_pty_slave(&pty), "-b", AGENT_RATE, NULL};
+	if (posix_spawnp(&agent, argv[1], NULL, NULL, agent_argv, environ) != 0)
+	{
+		printf("cannot start %s\n", argv[1]);
+		uart_pty_close(&pty);
+		return 1;
+	}
+
+	uxr_set_custom_transport_callbacks(&transport, true, cubemx_transport_open, cubemx_transport_close,
+			cubemx_transport_write, cubemx_transport_read);
+	if (!uxr_init_custom_transport(&transport, uart))
+	{
+		printf("transport open failed\n");
+		kill(agent, SIGTERM);
+		waitpid(agent, NULL, 0);
+		uart_pty_close(&pty);
+		return 1;
+	}
+
+	uxr_init_session(&session, &transport.comm, SESSION_KEY);
+	for (int i = 0; (i < SESSION_TRIES) && !created; i++)
+	{
+		created = uxr_create_session(&session);
+	}
+
+	for (uint32_t i = 0; created && (i < pings); i++)
+	{
+		TickType_t start = xTaskGetTickCount();
+
+		if (!uxr_ping_agent_session(&session, PING_TIMEOUT_MS, 1))
+		{
+			lost++;
+			continue;
+		}
+		uint32_t rtt = xTaskGetTickCount() - start;
+		rtt_sum += rtt;
+		rtt_max = (rtt > rtt_max) ? rtt : rtt_max;
+	}
+
+	if (created)
+	{
+		uint32_t answered = pings - lost;
+		printf("session created, %u of %u pings answered, rtt avg %u ms max %u ms\n", (unsigned)answered,
+				(unsigned)pings, (unsigned)(answered ? rtt_sum / answered : 0), (unsigned)rtt_max);
+		uxr_delete_session(&session);
+	}
+	else
+	{
+		printf("no session with the agent\n");
+	}
+
+	const transport_stats *stats = cubemx_transport_get_stats();
+	printf("transport: %u bytes out, %u bytes in, %u rx overruns\n", (unsigned)stats->bytes_out,
+			(unsigned)stats->bytes_in, (unsigned)stats->rx_overruns);
+
+	uxr_close_custom_transport(&transport);
+	kill(agent, SIGTERM);
+	waitpid(agent, NULL, 0);
+	uart_pty_close(&pty);
+
+	return (created && (lost == 0)) ? 0 : 1;
+}
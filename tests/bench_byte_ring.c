@@ -0,0 +1,114 @@
+/*
+ * bench_byte_ring.c
+ *
+ *  Throughput of the micro-ROS RX drain: the former per-byte copy with a modulo per byte against
+ *  byte_ring_read, for several read sizes. A simulated circular DMA fills the buffer in bursts and the
+ *  reader drains it after each burst, as cubemx_transport_read does after an RX event.
+ *  The per-byte drain is inlined here, while byte_ring costs two calls per read, so 1-byte reads
+ *  stay slower than the inlined loop.
+ *  usage: bench_byte_ring [megabytes per run, default 16]
+ */
+
+#include "byte_ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DMA_BUFFER_SIZE 2048  /* UART_DMA_BUFFER_SIZE of dma_transport.c */
+#define DMA_BURST       256   /* bytes between two RX events */
+
+static uint8_t dma_buffer[DMA_BUFFER_SIZE];
+static uint32_t dma_pos;
+static uint8_t dma_value;
+
+static void dma_burst(void)
+{
+	for (uint32_t i = 0; i < DMA_BURST; i++)
+	{
+		dma_buffer[(dma_pos + i) & (DMA_BUFFER_SIZE - 1)] = dma_value++;
+	}
+	dma_pos = (dma_pos + DMA_BURST) & (DMA_BUFFER_SIZE - 1);
+}
+
+/* the drain of cubemx_transport_read before the byte_ring */
+static uint32_t byte_head;
+
+static size_t read_per_byte(uint8_t *buf, size_t len)
+{
+	size_t wrote = 0;
+	uint32_t tail = dma_pos;
+
+	while ((byte_head != tail) && (wrote < len))
+	{
+		buf[wrote] = dma_buffer[byte_head];
+		byte_head = (byte_head + 1) % DMA_BUFFER_SIZE;
+		wrote++;
+	}
+	return wrote;
+}
+
+static byte_ring ring;
+
+static size_t read_ring(uint8_t *buf, size_t len)
+{
+	byte_ring_dma_update(&ring, dma_pos);
+	return byte_ring_read(&ring, buf, len);
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* run total bytes through the drain, returns ns per byte and the checksum of what was read */
+static double run(size_t (*drain)(uint8_t *, size_t), size_t read_len, size_t total, uint32_t *sum)
+{
+	static uint8_t buf[DMA_BUFFER_SIZE];
+	double start = now_s();
+
+	*sum = 0;
+	dma_pos = 0;
+	dma_value = 0;
+	byte_head = 0;
+	byte_ring_init(&ring, dma_buffer, DMA_BUFFER_SIZE);
+
+	for (size_t done = 0; done < total; )
+	{
+		size_t got;
+
+		dma_burst();
+		while ((got = drain(buf, read_len)) != 0)
+		{
+			*sum += buf[0] + buf[got - 1];
+			done += got;
+		}
+	}
+
+	return (now_s() - start) * 1e9 / total;
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t read_lens[] = {1, 16, 64, 512};
+	size_t total = (argc > 1) ? strtoul(argv[1], NULL, 10) << 20 : 16u << 20;
+	int failed = 0;
+
+	printf("%-8s %12s %12s %8s\n", "read", "per byte", "byte_ring", "speedup");
+	for (size_t i = 0; i < sizeof(read_lens) / sizeof(read_lens[0]); i++)
+	{
+		uint32_t sum_byte, sum_ring;
+		double byte_ns = run(read_per_byte, read_lens[i], total, &sum_byte);
+		double ring_ns = run(read_ring, read_lens[i], total, &sum_ring);
+
+		printf("%-8zu %9.3f ns %9.3f ns %7.1fx\n", read_lens[i], byte_ns, ring_ns, byte_ns / ring_ns);
+		if (sum_byte != sum_ring)
+		{
+			printf("read size %zu: the drains returned different data\n", read_lens[i]);
+			failed = 1;
+		}
+	}
+
+	return failed;
+}
@@ -0,0 +1,180 @@
+/*
+ * bench_dma_transport.c
+ *
+ *  The micro-ROS UART transport over the simulated UART, for one RX DMA buffer size
+ *  (UART_DMA_BUFFER_SIZE, one executable per size) and the rates the rover offers:
+ *  - echo: round trips of one message, as a request and its reply, with the line use of one direction
+ *  - stall: a continuous echo stream read by a reader that stops for stall_ms after every 4 KiB,
+ *    like an executor busy in a callback; the bytes lost to RX overruns depend on the buffer size
+ *  usage: bench_dma_transport [seconds per case, default 1] [stall ms, default 10]
+ *  Every rate runs in its own process, the transport keeps the agreed rate in static state.
+ */
+
+#include "transport_host.h"
+#include "uart_pty.h"
+#include "pty_peer.h"
+#include "task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEFAULT_RATE 115200
+#define STREAM_WRITE 512
+#define STREAM_BLOCK 4096
+
+static struct uxrCustomTransport transport;
+static volatile int stream_done;
+static uint32_t stream_ms;
+static uint64_t stream_written;
+
+static void *stream_writer(void *arg)
+{
+	static uint8_t data[STREAM_WRITE];
+	TickType_t start = xTaskGetTickCount();
+	uint8_t err = 0;
+
+	(void)arg;
+	memset(data, 0x5A, sizeof(data));
+	while (xTaskGetTickCount() - start < stream_ms)
+	{
+		stream_written += cubemx_transport_write(&transport, data, sizeof(data), &err);
+	}
+	stream_done = 1;
+	return NULL;
+}
+
+static void bench_echo(uint32_t rate, size_t len, uint32_t ms)
+{
+	static uint8_t out[512], in[512];
+	uint32_t trips = 0;
+	uint8_t err = 0;
+
+	memset(out, 0xA5, len);
+	TickType_t start = xTaskGetTickCount();
+	while (xTaskGetTickCount() - start < ms)
+	{
+		size_t got = 0;
+
+		for (size_t sent = 0; sent < len; )
+		{
+			sent += cubemx_transport_write(&transport, out + sent, len - sent, &err);
+		}
+		while (got < len)
+		{
+			size_t n = cubemx_transport_read(&transport, in + got, len - got, 100, &err);
+			if (n == 0)
+			{
+				break;
+			}
+			got += n;
+		}
+		trips++;
+	}
+
+	double s = (xTaskGetTickCount() - start) / 1000.0;
+	double bytes_per_s = trips * len / s;
+	printf("%-8u %-6s %5zu %10.0f %10.1f %7.0f%%\n", (unsigned)rate, "echo", len, s * 1e6 / trips,
+			bytes_per_s / 1000, 100.0 * bytes_per_s * 10 / rate);
+}
+
+static void bench_stall(uint32_t rate, uint32_t ms, uint32_t stall_ms)
+{
+	static uint8_t in[512];
+	pthread_t writer;
+	uint64_t read = 0, block = 0;
+	uint8_t err = 0;
+
+	cubemx_transport_reset_stats();
+	stream_done = 0;
+	stream_written = 0;
+	stream_ms = ms;
+	pthread_create(&writer, NULL, stream_writer, NULL);
+
+	for (TickType_t last = xTaskGetTickCount(); !stream_done || (xTaskGetTickCount() - last < 200); )
+	{
+		size_t n = cubemx_transport_read(&transport, in, sizeof(in), 10, &err);
+
+		if (n != 0)
+		{
+			last = xTaskGetTickCount();
+		}
+		read += n;
+		block += n;
+		if (block >= STREAM_BLOCK)
+		{
+			block = 0;
+			vTaskDelay(stall_ms);
+		}
+	}
+	pthread_join(writer, NULL);
+
+	uint64_t lost = stream_written - read;
+	printf("%-8u %-6s %5u %10llu %10llu %7.1f%%  %u overruns\n", (unsigned)rate, "stall", (unsigned)stall_ms,
+			(unsigned long long)stream_written, (unsigned long long)lost,
+			stream_written ? 100.0 * lost / stream_written : 0.0, (unsigned)cubemx_transport_get_stats()->rx_overruns);
+}
+
+static int bench_rate(uint32_t rate, uint32_t ms, uint32_t stall_ms)
+{
+	static const size_t lens[] = {16, 128, 512};
+	uart_pty pty;
+	pty_peer peer;
+	UART_HandleTypeDef *uart = uart_pty_open(&pty, DEFAULT_RATE);
+
+	if ((uart == NULL) || (pty_peer_start(&peer, uart_pty_slave(&pty), (rate == DEFAULT_RATE) ? 0 : rate) != 0))
+	{
+		printf("no pty available\n");
+		return 1;
+	}
+
+	transport.args = uart;
+	cubemx_transport_open(&transport);
+	if (uart->Init.BaudRate != rate)
+	{
+		printf("%u: negotiated %u\n", (unsigned)rate, (unsigned)uart->Init.BaudRate);
+		return 1;
+	}
+
+	for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+	{
+		bench_echo(rate, lens[i], ms);
+	}
+	bench_stall(rate, ms, stall_ms);
+
+	cubemx_transport_close(&transport);
+	pty_peer_stop(&peer);
+	uart_pty_close(&pty);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const uint32_t rates[] = {DEFAULT_RATE, 921600, 3000000};
+	uint32_t ms = (argc > 1) ? (uint32_t)(atof(argv[1]) * 1000) : 1000;
+	uint32_t stall_ms = (argc > 2) ? strtoul(argv[2], NULL, 10) : 10;
+	int failed = 0;
+
+	printf("RX DMA buffer %u bytes\n", (unsigned)UART_DMA_BUFFER_SIZE);
+	printf("%-8s %-6s %5s %10s %10s %8s\n", "rate", "case", "bytes", "rtt us", "kB/s", "line");
+	printf("%-8s %-6s %5s %10s %10s %8s\n", "", "", "stall", "written", "lost", "");
+	fflush(stdout);
+
+	for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+	{
+		pid_t pid = fork();
+		int status;
+
+		if (pid == 0)
+		{
+			int result = bench_rate(rates[i], ms, stall_ms);
+			fflush(stdout);
+			_exit(result);
+		}
+		waitpid(pid, &status, 0);
+		failed |= !WIFEXITED(status) || (WEXITSTATUS(status) != 0);
+	}
+
+	return failed;
+}
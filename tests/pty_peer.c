@@ -0,0 +1,188 @@
+/*
+ * pty_peer.c
+ */
+
+#include "pty_peer.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PEER_POLL_MS   10
+#define PEER_REPLY_MS  500
+
+static void peer_write(pty_peer *peer, const void *data, size_t len)
+{
+	const uint8_t *bytes = data;
+
+	while ((len != 0) && peer->running)
+	{
+		ssize_t done = write(peer->fd, bytes, len);
+
+		if (done <= 0)
+		{
+			struct pollfd pfd = {peer->fd, POLLOUT, 0};
+			poll(&pfd, 1, PEER_POLL_MS);
+			continue;
+		}
+		bytes += done;
+		len -= done;
+	}
+}
+
+/* one '\n' terminated line, false after timeout_ms without one */
+static bool peer_read_line(pty_peer *peer, char *line, size_t size, int timeout_ms)
+{
+	size_t n = 0;
+
+	for (int waited = 0; (waited < timeout_ms) && peer->running; )
+	{
+		struct pollfd pfd = {peer->fd, POLLIN, 0};
+		char c;
+
+		if (poll(&pfd, 1, PEER_POLL_MS) <= 0)
+		{
+			waited += PEER_POLL_MS;
+			continue;
+		}
+		if (read(peer->fd, &c, 1) != 1)
+		{
+			continue;
+		}
+		if (c == '\n')
+		{
+			line[n] = '\0';
+			return true;
+		}
+		if (n < size - 1)
+		{
+			line[n++] = c;
+		}
+	}
+	return false;
+}
+
+/* host side of the negotiation of dma_transport.c, as tools/microros_baud.py does it */
+static void peer_negotiate(pty_peer *peer)
+{
+	char line[96];
+	uint32_t best = 0;
+
+	if (!peer_read_line(peer, line, sizeof(line), PEER_REPLY_MS) || (strncmp(line, "$BAUD?", 6) != 0))
+	{
+		return;
+	}
+
+	for (char *rate = line + 6; *rate != '\0'; )
+	{
+		char *end;
+		uint32_t value = strtoul(rate, &end, 10);
+
+		if ((value <= peer->max_rate) && (value > best))
+		{
+			best = value;
+		}
+		rate = (*end == ',') ? end + 1 : end + strlen(end);
+	}
+	if (best == 0)
+	{
+		return;
+	}
+
+	int len = snprintf(line, sizeof(line), "$BAUD=%u\n", (unsigned)best);
+	peer_write(peer, line, len);
+	if (!peer_read_line(peer, line, sizeof(line), PEER_REPLY_MS) || (strcmp(line, "$BAUD OK") != 0))
+	{
+		return;
+	}
+
+	// the pty has no line rate, only the rover side paces at the new one
+	nanosleep(&(struct timespec){0, 10000000}, NULL);
+	peer_write(peer, "$BAUD!\n", 7);
+	if (peer_read_line(peer, line, sizeof(line), PEER_REPLY_MS) && (strcmp(line, "$BAUD!") == 0))
+	{
+		peer->rate = best;
+		peer->negotiations++;
+		peer->negotiating = false;
+	}
+}
+
+static void *peer_main(void *arg)
+{
+	pty_peer *peer = arg;
+	uint8_t buf[256];
+
+	while (peer->running)
+	{
+		if (peer->negotiating)
+		{
+			peer_negotiate(peer);
+			continue;
+		}
+
+		struct pollfd pfd = {peer->fd, POLLIN, 0};
+		if (poll(&pfd, 1, PEER_POLL_MS) <= 0)
+		{
+			continue;
+		}
+
+		ssize_t n = read(peer->fd, buf, sizeof(buf));
+		if (n > 0)
+		{
+			peer_write(peer, buf, n);
+			peer->echoed += n;
+		}
+	}
+
+	return NULL;
+}
+
+/*	@brief open the slave side of the pty and start answering
+ * 	@param peer: peer state
+ * 	@param path: slave side, see uart_pty_slave
+ * 	@param max_rate: highest rate to accept from an offer, 0 to echo from the start
+ * 	@retval: 0, or -1 if the pty could not be opened
+ * */
+int pty_peer_start(pty_peer *peer, const char *path, uint32_t max_rate)
+{
+	struct termios raw;
+
+	memset(peer, 0, sizeof(*peer));
+	peer->fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if ((peer->fd < 0) || (tcgetattr(peer->fd, &raw) != 0))
+	{
+		return -1;
+	}
+	cfmakeraw(&raw);
+	tcsetattr(peer->fd, TCSANOW, &raw);
+
+	peer->max_rate = max_rate;
+	peer->negotiating = (max_rate != 0);
+	peer->running = true;
+	pthread_create(&peer->thread, NULL, peer_main, peer);
+	return 0;
+}
+
+/*	@brief behave like a restarted host: wait for an offer again
+ * 	@param peer: peer state
+ * 	@retval: none
+ * */
+void pty_peer_renegotiate(pty_peer *peer)
+{
+	peer->negotiating = (peer->max_rate != 0);
+}
+
+/*	@brief stop answering and close the slave side
+ * 	@param peer: peer state
+ * 	@retval: none
+ * */
+void pty_peer_stop(pty_peer *peer)
+{
+	peer->running = false;
+	pthread_join(peer->thread, NULL);
+	close(peer->fd);
+}
@@ -0,0 +1,30 @@
+/*
+ * pty_peer.h
+ *
+ *  Host end of the simulated UART for the transport tests: answers the baud rate offers like
+ *  tools/microros_baud.py, then echoes everything back.
+ */
+
+#ifndef TESTS_PTY_PEER_H_
+#define TESTS_PTY_PEER_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct{
+	int fd;
+	pthread_t thread;
+	volatile bool running;
+	volatile bool negotiating;       /* waiting for an offer, nothing is echoed meanwhile */
+	uint32_t max_rate;               /* highest rate accepted from an offer */
+	volatile uint32_t rate;          /* last agreed rate */
+	volatile uint32_t negotiations;  /* agreements */
+	volatile uint64_t echoed;        /* bytes echoed back */
+}pty_peer;
+
+int pty_peer_start(pty_peer *peer, const char *path, uint32_t max_rate);
+void pty_peer_renegotiate(pty_peer *peer);
+void pty_peer_stop(pty_peer *peer);
+
+#endif /* TESTS_PTY_PEER_H_ */
@@ -0,0 +1,25 @@
+/*
+ * FreeRTOS.h (host shim)
+ *
+ *  Ticks of 1 ms on the host monotonic clock, tasks are POSIX threads, see freertos_host.c.
+ */
+
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE  ((BaseType_t)1)
+
+#define configTICK_RATE_HZ 1000
+#define portMAX_DELAY      ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(xTimeInMs))
+
+#define portYIELD_FROM_ISR(x) ((void)(x))
+
+#endif /* INC_FREERTOS_H */
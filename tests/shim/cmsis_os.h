@@ -0,0 +1,13 @@
+/*
+ * cmsis_os.h (host shim)
+ *
+ *  Nothing of CMSIS-RTOS is used by the transport besides what FreeRTOS.h and task.h provide.
+ */
+
+#ifndef CMSIS_OS_H_
+#define CMSIS_OS_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#endif /* CMSIS_OS_H_ */
@@ -0,0 +1,165 @@
+/*
+ * freertos_host.c
+ *
+ *  Host implementation of the FreeRTOS, CMSIS and RCC calls of the shims: ticks and the cycle counter
+ *  on CLOCK_MONOTONIC, task notifications on a mutex and condition variable per thread, and PRIMASK
+ *  as a process wide lock held by the thread that masked the interrupts.
+ */
+
+#include "main.h"
+#include "task.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct host_task{
+	pthread_mutex_t lock;
+	pthread_cond_t given;
+	uint32_t count;
+};
+
+static pthread_mutex_t irq_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local uint32_t primask;
+static _Thread_local struct host_task *current_task;
+
+uint32_t SystemCoreClock = 168000000;
+CoreDebug_Type host_core_debug;
+USART_TypeDef host_usart[6] = {{1}, {2}, {3}, {4}, {5}, {6}};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint64_t boot_ns;
+
+__attribute__((constructor)) static void host_boot(void)
+{
+	boot_ns = now_ns();
+}
+
+static uint64_t start_ns(void)
+{
+	return boot_ns;
+}
+
+/* CMSIS core */
+uint32_t __get_PRIMASK(void)
+{
+	return primask;
+}
+
+void __set_PRIMASK(uint32_t mask)
+{
+	if (mask && !primask)
+	{
+		pthread_mutex_lock(&irq_lock);
+	}
+	else if (!mask && primask)
+	{
+		pthread_mutex_unlock(&irq_lock);
+	}
+	primask = mask ? 1 : 0;
+}
+
+void __disable_irq(void)
+{
+	__set_PRIMASK(1);
+}
+
+void __enable_irq(void)
+{
+	__set_PRIMASK(0);
+}
+
+DWT_Type *host_dwt(void)
+{
+	static _Thread_local DWT_Type dwt;
+
+	dwt.CYCCNT = (uint32_t)((now_ns() - start_ns()) * (SystemCoreClock / 1000000u) / 1000u);
+	return &dwt;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return SystemCoreClock / 4;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+	return SystemCoreClock / 2;
+}
+
+/* FreeRTOS */
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)((now_ns() - start_ns()) / 1000000u);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	if (current_task == NULL)
+	{
+		current_task = calloc(1, sizeof(*current_task));
+		pthread_mutex_init(&current_task->lock, NULL);
+		pthread_cond_init(&current_task->given, NULL);
+	}
+	return current_task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+	struct host_task *task = xTaskGetCurrentTaskHandle();
+	struct timespec deadline;
+	uint32_t count;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += xTicksToWait / 1000;
+	deadline.tv_nsec += (long)(xTicksToWait % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&task->lock);
+	while (task->count == 0)
+	{
+		if (pthread_cond_timedwait(&task->given, &task->lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+	count = task->count;
+	if (count != 0)
+	{
+		task->count = xClearCountOnExit ? 0 : count - 1;
+	}
+	pthread_mutex_unlock(&task->lock);
+
+	return count;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	pthread_mutex_lock(&xTaskToNotify->lock);
+	xTaskToNotify->count++;
+	pthread_cond_signal(&xTaskToNotify->given);
+	pthread_mutex_unlock(&xTaskToNotify->lock);
+
+	if (pxHigherPriorityTaskWoken != NULL)
+	{
+		*pxHigherPriorityTaskWoken = pdFALSE;
+	}
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+	struct timespec ts = {xTicksToDelay / 1000, (long)(xTicksToDelay % 1000) * 1000000};
+
+	nanosleep(&ts, NULL);
+}
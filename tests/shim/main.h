@@ -0,0 +1,124 @@
+/*
+ * main.h (host shim)
+ *
+ *  The part of the STM32 HAL and CMSIS used by the micro-ROS transport, for a host build against
+ *  the pty UART of uart_pty.c. It takes the include guard of Core/Inc/main.h, and the CMake target
+ *  force-includes it, so the Core headers that include "main.h" get this one.
+ *
+ *  PRIMASK is a process wide lock: __disable_irq takes it, and the simulated interrupts of
+ *  uart_pty.c run holding it, so a masked section excludes them as on the target.
+ */
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum
+{
+	HAL_OK = 0,
+	HAL_ERROR,
+	HAL_BUSY,
+	HAL_TIMEOUT
+}HAL_StatusTypeDef;
+
+/* CMSIS core */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+/* cycle counter, SystemCoreClock ticks of the host monotonic clock */
+typedef struct{
+	uint32_t CTRL;
+	uint32_t CYCCNT;
+}DWT_Type;
+
+typedef struct{
+	uint32_t DEMCR;
+}CoreDebug_Type;
+
+DWT_Type *host_dwt(void);
+extern CoreDebug_Type host_core_debug;
+extern uint32_t SystemCoreClock;
+
+#define DWT                         (host_dwt())
+#define CoreDebug                   (&host_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk      0x1UL
+#define CoreDebug_DEMCR_TRCENA_Msk  0x01000000UL
+
+/* DMA */
+typedef struct{
+	volatile uint32_t NDTR;
+}DMA_Stream_TypeDef;
+
+typedef struct{
+	DMA_Stream_TypeDef *Instance;
+}DMA_HandleTypeDef;
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__) ((__HANDLE__)->Instance->NDTR)
+
+/* UART */
+typedef struct{
+	uint32_t id;
+}USART_TypeDef;
+
+extern USART_TypeDef host_usart[6];
+#define USART1 (&host_usart[0])
+#define USART2 (&host_usart[1])
+#define USART3 (&host_usart[2])
+#define USART6 (&host_usart[5])
+
+typedef enum
+{
+	HAL_UART_STATE_RESET   = 0x00U,
+	HAL_UART_STATE_READY   = 0x20U,
+	HAL_UART_STATE_BUSY    = 0x24U,
+	HAL_UART_STATE_BUSY_TX = 0x21U,
+	HAL_UART_STATE_BUSY_RX = 0x22U
+}HAL_UART_StateTypeDef;
+
+#define UART_OVERSAMPLING_16 0x00000000U
+#define UART_OVERSAMPLING_8  0x00008000U
+
+#define HAL_UART_ERROR_NONE 0x00000000U
+#define HAL_UART_ERROR_PE   0x00000001U
+#define HAL_UART_ERROR_NE   0x00000002U
+#define HAL_UART_ERROR_FE   0x00000004U
+#define HAL_UART_ERROR_ORE  0x00000008U
+#define HAL_UART_ERROR_DMA  0x00000010U
+
+typedef struct{
+	uint32_t BaudRate;
+	uint32_t OverSampling;
+}UART_InitTypeDef;
+
+typedef struct __UART_HandleTypeDef{
+	USART_TypeDef *Instance;
+	UART_InitTypeDef Init;
+	DMA_HandleTypeDef *hdmatx;
+	DMA_HandleTypeDef *hdmarx;
+	volatile HAL_UART_StateTypeDef gState;
+	volatile HAL_UART_StateTypeDef RxState;
+	volatile uint32_t ErrorCode;
+	void *sim;  /* uart_pty state of the simulated UART */
+}UART_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef *huart);
+
+/* called by uart_pty.c from its simulated interrupts, defined by the test like main.c does */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+/* RCC, clocks of the STM32F446 at 168 MHz */
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+#endif /* __MAIN_H */
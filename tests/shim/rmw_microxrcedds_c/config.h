@@ -0,0 +1,12 @@
+/*
+ * rmw_microxrcedds_c/config.h (host shim)
+ *
+ *  The transport is built as the custom transport of micro-ROS, as in the firmware.
+ */
+
+#ifndef RMW_MICROXRCEDDS_C__CONFIG_H_
+#define RMW_MICROXRCEDDS_C__CONFIG_H_
+
+#define RMW_UXRCE_TRANSPORT_CUSTOM
+
+#endif /* RMW_MICROXRCEDDS_C__CONFIG_H_ */
@@ -0,0 +1,20 @@
+/*
+ * task.h (host shim)
+ *
+ *  Direct to task notifications between threads. A thread becomes a task on its first call.
+ */
+
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken);
+void vTaskDelay(TickType_t xTicksToDelay);
+
+#endif /* INC_TASK_H */
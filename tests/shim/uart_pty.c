@@ -0,0 +1,350 @@
+/*
+ * uart_pty.c
+ *
+ *  The UART runs at Init.BaudRate with 10 bits per byte. Both directions keep a schedule on the
+ *  monotonic clock rather than sleeping per chunk, so that the sleep overhead does not slow the line.
+ *  The HAL calls of this file follow the STM32F4 HAL: HAL_BUSY while a transfer runs, and the
+ *  abort functions stop both DMA streams without a callback.
+ */
+
+#include "uart_pty.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UART_PTY_POLL_MS 10
+
+/* advance the line schedule by n character times, restarting it when the line was idle */
+static void line_schedule(struct timespec *due, uint32_t baud, size_t n)
+{
+	struct timespec now;
+	uint64_t ns = (uint64_t)n * 10u * 1000000000u / baud;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((due->tv_sec < now.tv_sec) || ((due->tv_sec == now.tv_sec) && (due->tv_nsec < now.tv_nsec)))
+	{
+		*due = now;
+	}
+	due->tv_sec += ns / 1000000000u;
+	due->tv_nsec += ns % 1000000000u;
+	if (due->tv_nsec >= 1000000000)
+	{
+		due->tv_sec++;
+		due->tv_nsec -= 1000000000;
+	}
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, due, NULL);
+}
+
+/* write to the pins at the line rate, gives up when the UART is closed or the transfer aborted */
+static void line_write(uart_pty *pty, const uint8_t *data, size_t len, const uint32_t *generation)
+{
+	struct timespec due = {0, 0};
+
+	while ((len != 0) && pty->running)
+	{
+		if ((generation != NULL) && (*generation != pty->tx_generation))
+		{
+			return;
+		}
+
+		size_t n = (len < UART_PTY_RX_CHUNK) ? len : UART_PTY_RX_CHUNK;
+		ssize_t done = write(pty->master, data, n);
+
+		if (done <= 0)
+		{
+			struct pollfd pfd = {pty->master, POLLOUT, 0};
+			poll(&pfd, 1, UART_PTY_POLL_MS);
+			continue;
+		}
+		line_schedule(&due, pty->huart.Init.BaudRate, done);
+		data += done;
+		len -= done;
+	}
+}
+
+/* DMA write of received bytes into the circular buffer, with the interrupts masked */
+static void rx_deliver(uart_pty *pty, const uint8_t *data, size_t len)
+{
+	if (!pty->rx_active)
+	{
+		pty->rx_dropped += len;
+		return;
+	}
+
+	for (size_t i = 0; i < len; i++)
+	{
+		pty->rx_buffer[pty->rx_pos++] = data[i];
+		if (pty->rx_pos == pty->rx_size)
+		{
+			pty->rx_pos = 0;
+		}
+		pty->rx_stream.NDTR = pty->rx_size - pty->rx_pos;
+
+		if (pty->rx_pos == pty->rx_size / 2)
+		{
+			HAL_UARTEx_RxEventCallback(&pty->huart, pty->rx_size / 2);
+		}
+		else if (pty->rx_pos == 0)
+		{
+			HAL_UARTEx_RxEventCallback(&pty->huart, pty->rx_size);
+		}
+	}
+}
+
+static void *rx_main(void *arg)
+{
+	uart_pty *pty = arg;
+	uint8_t chunk[UART_PTY_RX_CHUNK];
+	struct timespec due = {0, 0};
+
+	while (pty->running)
+	{
+		struct pollfd pfd = {pty->master, POLLIN, 0};
+
+		if (poll(&pfd, 1, UART_PTY_POLL_MS) <= 0)
+		{
+			continue;
+		}
+
+		ssize_t n = read(pty->master, chunk, sizeof(chunk));
+		if (n <= 0)
+		{
+			continue;
+		}
+
+		// the bytes take n character times on the line
+		line_schedule(&due, pty->huart.Init.BaudRate, n);
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		rx_deliver(pty, chunk, n);
+
+		// idle line event when the peer has nothing more to send
+		pfd.revents = 0;
+		if (pty->rx_active && (poll(&pfd, 1, 0) == 0))
+		{
+			HAL_UARTEx_RxEventCallback(&pty->huart, pty->rx_pos);
+		}
+
+		__set_PRIMASK(primask);
+	}
+
+	return NULL;
+}
+
+static void *tx_main(void *arg)
+{
+	uart_pty *pty = arg;
+
+	while (pty->running)
+	{
+		pthread_mutex_lock(&pty->tx_lock);
+		while (pty->running && (pty->tx_data == NULL))
+		{
+			pthread_cond_wait(&pty->tx_start, &pty->tx_lock);
+		}
+		const uint8_t *data = pty->tx_data;
+		uint16_t size = pty->tx_size;
+		uint32_t generation = pty->tx_generation;
+		pthread_mutex_unlock(&pty->tx_lock);
+
+		if (data == NULL)
+		{
+			break;
+		}
+
+		line_write(pty, data, size, &generation);
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		pthread_mutex_lock(&pty->tx_lock);
+		bool completed = (generation == pty->tx_generation) && (pty->tx_data == data);
+		if (completed)
+		{
+			pty->tx_data = NULL;
+		}
+		pthread_mutex_unlock(&pty->tx_lock);
+
+		if (completed)
+		{
+			pty->huart.gState = HAL_UART_STATE_READY;
+			HAL_UART_TxCpltCallback(&pty->huart);
+		}
+
+		__set_PRIMASK(primask);
+	}
+
+	return NULL;
+}
+
+/*	@brief create the pty and start the UART, like MX_USARTx_UART_Init
+ * 	@param pty: UART state
+ * 	@param baud: initial rate
+ * 	@retval: UART handle, NULL if no pty could be created
+ * */
+UART_HandleTypeDef *uart_pty_open(uart_pty *pty, uint32_t baud)
+{
+	struct termios raw;
+
+	memset(pty, 0, sizeof(*pty));
+	pty->master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((pty->master < 0) || (grantpt(pty->master) != 0) || (unlockpt(pty->master) != 0) ||
+			(ptsname_r(pty->master, pty->slave_name, sizeof(pty->slave_name)) != 0))
+	{
+		return NULL;
+	}
+
+	pty->slave = open(pty->slave_name, O_RDWR | O_NOCTTY);
+	if ((pty->slave < 0) || (tcgetattr(pty->slave, &raw) != 0))
+	{
+		return NULL;
+	}
+	cfmakeraw(&raw);
+	tcsetattr(pty->slave, TCSANOW, &raw);
+	fcntl(pty->master, F_SETFL, fcntl(pty->master, F_GETFL) | O_NONBLOCK);
+
+	pty->rx_stream.NDTR = 0;
+	pty->hdmarx.Instance = &pty->rx_stream;
+	pty->hdmatx.Instance = &pty->tx_stream;
+	pty->huart.Instance = USART3;
+	pty->huart.Init.BaudRate = baud;
+	pty->huart.Init.OverSampling = UART_OVERSAMPLING_16;
+	pty->huart.hdmarx = &pty->hdmarx;
+	pty->huart.hdmatx = &pty->hdmatx;
+	pty->huart.sim = pty;
+	HAL_UART_Init(&pty->huart);
+
+	pthread_mutex_init(&pty->tx_lock, NULL);
+	pthread_cond_init(&pty->tx_start, NULL);
+	pty->running = true;
+	pthread_create(&pty->rx_thread, NULL, rx_main, pty);
+	pthread_create(&pty->tx_thread, NULL, tx_main, pty);
+
+	return &pty->huart;
+}
+
+/*	@brief path of the slave side, for the peer
+ * 	@param pty: UART state
+ * 	@retval: e.g. /dev/pts/3
+ * */
+const char *uart_pty_slave(const uart_pty *pty)
+{
+	return pty->slave_name;
+}
+
+/*	@brief stop the UART threads and remove the pty
+ * 	@param pty: UART state
+ * 	@retval: none
+ * */
+void uart_pty_close(uart_pty *pty)
+{
+	pthread_mutex_lock(&pty->tx_lock);
+	pty->running = false;
+	pthread_cond_signal(&pty->tx_start);
+	pthread_mutex_unlock(&pty->tx_lock);
+
+	pthread_join(pty->rx_thread, NULL);
+	pthread_join(pty->tx_thread, NULL);
+	close(pty->slave);
+	close(pty->master);
+}
+
+/* HAL */
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+	huart->ErrorCode = HAL_UART_ERROR_NONE;
+	huart->gState = HAL_UART_STATE_READY;
+	huart->RxState = HAL_UART_STATE_READY;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+
+	if (huart->gState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	line_write(huart->sim, pData, Size, NULL);
+	huart->gState = HAL_UART_STATE_READY;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+	uart_pty *pty = huart->sim;
+
+	if (huart->gState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	pthread_mutex_lock(&pty->tx_lock);
+	pty->tx_data = pData;
+	pty->tx_size = Size;
+	pthread_cond_signal(&pty->tx_start);
+	pthread_mutex_unlock(&pty->tx_lock);
+
+	__set_PRIMASK(primask);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	uart_pty *pty = huart->sim;
+
+	if (huart->RxState != HAL_UART_STATE_READY)
+	{
+		return HAL_BUSY;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	pty->rx_buffer = pData;
+	pty->rx_size = Size;
+	pty->rx_pos = 0;
+	pty->rx_stream.NDTR = Size;
+	pty->rx_active = true;
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+	__set_PRIMASK(primask);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart)
+{
+	uart_pty *pty = huart->sim;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	pty->rx_active = false;
+	huart->RxState = HAL_UART_STATE_READY;
+
+	pthread_mutex_lock(&pty->tx_lock);
+	pty->tx_data = NULL;
+	pty->tx_generation++;
+	pthread_mutex_unlock(&pty->tx_lock);
+	huart->gState = HAL_UART_STATE_READY;
+
+	__set_PRIMASK(primask);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef *huart)
+{
+	return HAL_UART_DMAStop(huart);
+}
@@ -0,0 +1,50 @@
+/*
+ * uart_pty.h
+ *
+ *  Simulated STM32 UART with its RX and TX DMA streams, on the master side of a pseudo terminal.
+ *  The peer, a test thread or a micro-ROS agent, opens the slave side like a serial port.
+ *
+ *  RX: the bytes from the peer are written into the circular DMA buffer at the UART rate, NDTR
+ *  counts down, and the half transfer, transfer complete and idle line events call
+ *  HAL_UARTEx_RxEventCallback. TX: a DMA transfer is written out at the UART rate, then
+ *  HAL_UART_TxCpltCallback is called. The callbacks run with the simulated interrupts masked.
+ */
+
+#ifndef TESTS_SHIM_UART_PTY_H_
+#define TESTS_SHIM_UART_PTY_H_
+
+#include "main.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+#define UART_PTY_RX_CHUNK 64  /* bytes delivered per RX step, at most half of the DMA buffer */
+
+typedef struct{
+	UART_HandleTypeDef huart;
+	DMA_HandleTypeDef hdmarx, hdmatx;
+	DMA_Stream_TypeDef rx_stream, tx_stream;
+	int master;                  /* pty master, the UART pins */
+	int slave;                   /* kept open so that the master survives the peer closing */
+	char slave_name[64];
+	pthread_t rx_thread, tx_thread;
+	volatile bool running;
+	/* RX DMA, changed with the interrupts masked */
+	uint8_t *rx_buffer;
+	uint16_t rx_size;
+	uint16_t rx_pos;
+	bool rx_active;
+	/* TX DMA */
+	pthread_mutex_t tx_lock;
+	pthread_cond_t tx_start;
+	const uint8_t *tx_data;
+	uint16_t tx_size;
+	volatile uint32_t tx_generation; /* bumped by an abort, a transfer of an older generation stops silently */
+	/* counters */
+	uint32_t rx_dropped;         /* bytes received while no reception was running */
+}uart_pty;
+
+UART_HandleTypeDef *uart_pty_open(uart_pty *pty, uint32_t baud);
+const char *uart_pty_slave(const uart_pty *pty);
+void uart_pty_close(uart_pty *pty);
+
+#endif /* TESTS_SHIM_UART_PTY_H_ */
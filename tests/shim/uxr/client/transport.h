@@ -0,0 +1,15 @@
+/*
+ * uxr/client/transport.h (host shim)
+ *
+ *  The custom transport handle as far as the transport callbacks use it. The agent loopback target
+ *  builds against the real Micro XRCE-DDS client headers instead.
+ */
+
+#ifndef UXR_CLIENT_TRANSPORT_H_
+#define UXR_CLIENT_TRANSPORT_H_
+
+struct uxrCustomTransport{
+	void *args;
+};
+
+#endif /* UXR_CLIENT_TRANSPORT_H_ */
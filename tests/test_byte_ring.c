@@ -0,0 +1,169 @@
+/*
+ * test_byte_ring.c
+ *
+ *  byte_ring: copies across the wrap, and a circular DMA writer simulated by moving its position
+ *  the way the half/full transfer events of the UART reception do.
+ */
+
+#include "byte_ring.h"
+#include "test_check.h"
+#include <string.h>
+
+#define RING_SIZE 16
+
+static uint8_t storage[RING_SIZE];
+
+/* write len bytes at the DMA position, reporting the position every half buffer like the RX events */
+static uint32_t dma_write(byte_ring *ring, uint32_t *pos, uint8_t *value, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++)
+	{
+		storage[*pos] = (*value)++;
+		*pos = (*pos + 1) & (RING_SIZE - 1);
+		if ((*pos & (RING_SIZE / 2 - 1)) == 0)
+		{
+			byte_ring_dma_update(ring, *pos);
+		}
+	}
+	return byte_ring_dma_update(ring, *pos);
+}
+
+static void test_wrap(void)
+{
+	byte_ring ring;
+	uint8_t in[RING_SIZE], out[RING_SIZE];
+
+	for (uint8_t i = 0; i < RING_SIZE; i++)
+	{
+		in[i] = i + 1;
+	}
+
+	byte_ring_init(&ring, storage, RING_SIZE);
+	CHECK(byte_ring_write(&ring, in, 10) == 10);
+	CHECK(byte_ring_read(&ring, out, 10) == 10);
+
+	// 12 bytes from offset 10: 6 before the wrap and 6 after
+	CHECK(byte_ring_write(&ring, in, 12) == 12);
+	CHECK(byte_ring_used(&ring) == 12);
+	CHECK(byte_ring_free(&ring) == RING_SIZE - 12);
+
+	uint8_t *block;
+	CHECK(byte_ring_linear(&ring, &block) == 6);
+	CHECK(block == &storage[10]);
+
+	memset(out, 0, sizeof(out));
+	CHECK(byte_ring_read(&ring, out, sizeof(out)) == 12);
+	CHECK(memcmp(out, in, 12) == 0);
+	CHECK(byte_ring_used(&ring) == 0);
+}
+
+/* reads of a few bytes, ending before the wrap or straddling it, return the stream in order */
+static void test_short_reads(void)
+{
+	byte_ring ring;
+	uint8_t in[RING_SIZE], out[5];
+	uint8_t next_in = 0, next_out = 0;
+
+	byte_ring_init(&ring, storage, RING_SIZE);
+	for (uint32_t round = 0; round < 4 * RING_SIZE; round++)
+	{
+		uint32_t len = round % 5 + 1;
+
+		while (byte_ring_free(&ring) >= len)
+		{
+			for (uint32_t i = 0; i < len; i++)
+			{
+				in[i] = next_in++;
+			}
+			byte_ring_write(&ring, in, len);
+		}
+
+		CHECK(byte_ring_read(&ring, out, len) == len);
+		for (uint32_t i = 0; i < len; i++)
+		{
+			CHECK(out[i] == next_out++);
+		}
+	}
+}
+
+static void test_full(void)
+{
+	byte_ring ring;
+	uint8_t in[RING_SIZE + 4] = {0}, out[RING_SIZE];
+
+	byte_ring_init(&ring, storage, RING_SIZE);
+	CHECK(byte_ring_write(&ring, in, 3) == 3);
+	CHECK(byte_ring_write(&ring, in, sizeof(in)) == RING_SIZE - 3);
+	CHECK(byte_ring_free(&ring) == 0);
+	CHECK(byte_ring_write(&ring, in, 1) == 0);
+
+	byte_ring_skip(&ring, 5);
+	CHECK(byte_ring_read(&ring, out, sizeof(out)) == RING_SIZE - 5);
+	CHECK(byte_ring_used(&ring) == 0);
+}
+
+static void test_dma_lap(void)
+{
+	byte_ring ring;
+	uint32_t pos = 0;
+	uint8_t value = 0;
+	uint8_t out[RING_SIZE];
+
+	byte_ring_init(&ring, storage, RING_SIZE);
+
+	// reader keeps up across several laps
+	for (int lap = 0; lap < 3; lap++)
+	{
+		uint8_t first = value;
+
+		dma_write(&ring, &pos, &value, 11);
+		CHECK(byte_ring_used(&ring) == 11);
+		CHECK(byte_ring_read(&ring, out, sizeof(out)) == 11);
+		CHECK(out[0] == first && out[10] == (uint8_t)(first + 10));
+	}
+
+	// exactly one lap unread: the buffer is full but intact, not an overrun
+	uint8_t first = value;
+	dma_write(&ring, &pos, &value, RING_SIZE);
+	CHECK(byte_ring_used(&ring) == RING_SIZE);
+	CHECK(byte_ring_read(&ring, out, sizeof(out)) == RING_SIZE);
+	CHECK(out[0] == first && out[RING_SIZE - 1] == (uint8_t)(first + RING_SIZE - 1));
+	CHECK(byte_ring_used(&ring) == 0);
+}
+
+static void test_dma_overrun(void)
+{
+	byte_ring ring;
+	uint32_t pos = 5;
+	uint8_t value = 0;
+
+	byte_ring_init(&ring, storage, RING_SIZE);
+	byte_ring_dma_update(&ring, pos);
+	byte_ring_skip(&ring, byte_ring_used(&ring));
+
+	// the writer laps the reader: more than a buffer pending shows the overrun
+	dma_write(&ring, &pos, &value, RING_SIZE + 3);
+	CHECK(byte_ring_used(&ring) == RING_SIZE + 3);
+	CHECK(byte_ring_used(&ring) > RING_SIZE);
+	CHECK(byte_ring_free(&ring) == 0);
+
+	// two laps unread, the overrun is still reported with the right count
+	dma_write(&ring, &pos, &value, RING_SIZE);
+	CHECK(byte_ring_used(&ring) == 2 * RING_SIZE + 3);
+
+	// the transport drops everything pending, then reads new data normally
+	byte_ring_skip(&ring, byte_ring_used(&ring));
+	dma_write(&ring, &pos, &value, 4);
+	CHECK(byte_ring_used(&ring) == 4);
+}
+
+int main(void)
+{
+	test_wrap();
+	test_short_reads();
+	test_full();
+	test_dma_lap();
+	test_dma_overrun();
+
+	return TEST_RESULT();
+}
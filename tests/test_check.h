@@ -0,0 +1,24 @@
+/*
+ * test_check.h
+ *
+ *  Minimal assertions for the host tests: a failed CHECK prints its location and the test
+ *  returns non-zero from TEST_RESULT.
+ */
+
+#ifndef TESTS_TEST_CHECK_H_
+#define TESTS_TEST_CHECK_H_
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_RESULT() (test_failures ? (printf("%d check(s) failed\n", test_failures), 1) : 0)
+
+#endif /* TESTS_TEST_CHECK_H_ */
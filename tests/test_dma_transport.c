@@ -0,0 +1,187 @@
+/*
+ * test_dma_transport.c
+ *
+ *  The micro-ROS UART transport (dma_transport.c) built on the host against the HAL and FreeRTOS
+ *  shims, over a simulated UART on a pty with an echoing peer: baud rate negotiation, loopback
+ *  integrity across the ring wraps, RX overrun detection, the TX drain on close, and the rate
+ *  alternation after a link timeout.
+ */
+
+#include "transport_host.h"
+#include "uart_pty.h"
+#include "pty_peer.h"
+#include "test_check.h"
+#include "task.h"
+#include <string.h>
+
+#define TEST_RATE        3000000
+#define TEST_DMA_BUFFER  2048     /* UART_DMA_BUFFER_SIZE of dma_transport.c */
+#define TEST_TX_BUFFER   2048     /* UART_TX_BUFFER_SIZE */
+#define TEST_LINK_MS     2100     /* past UART_LINK_TIMEOUT_MS */
+
+static uart_pty pty;
+static pty_peer peer;
+static UART_HandleTypeDef *uart;
+static struct uxrCustomTransport transport;
+
+/* write everything, retrying the partial writes like the XRCE session does */
+static void write_all(const uint8_t *data, size_t len)
+{
+	uint8_t err = 0;
+
+	while (len != 0)
+	{
+		size_t done = cubemx_transport_write(&transport, data, len, &err);
+
+		CHECK(done != 0);
+		if (done == 0)
+		{
+			return;
+		}
+		data += done;
+		len -= done;
+	}
+}
+
+/* read until len bytes arrived or timeout_ms passed, returns the number of bytes read */
+static size_t read_all(uint8_t *buf, size_t len, uint32_t timeout_ms)
+{
+	TickType_t start = xTaskGetTickCount();
+	size_t got = 0;
+	uint8_t err = 0;
+
+	while ((got < len) && (xTaskGetTickCount() - start < timeout_ms))
+	{
+		got += cubemx_transport_read(&transport, buf + got, len - got, 10, &err);
+	}
+	return got;
+}
+
+static void test_negotiation(void)
+{
+	CHECK(cubemx_transport_open(&transport));
+	CHECK(peer.negotiations == 1);
+	CHECK(peer.rate == TEST_RATE);
+	CHECK(uart->Init.BaudRate == TEST_RATE);
+	CHECK(uart->Init.OverSampling == UART_OVERSAMPLING_8);
+}
+
+static void test_loopback(void)
+{
+	static uint8_t out[512], in[512];
+	size_t total = 0;
+
+	cubemx_transport_reset_stats();
+	for (uint32_t frame = 0; frame < 200; frame++)
+	{
+		size_t len = 1 + (frame * 37) % sizeof(out);
+
+		for (size_t i = 0; i < len; i++)
+		{
+			out[i] = (uint8_t)(frame * 7 + i);
+		}
+		write_all(out, len);
+
+		memset(in, 0, len);
+		CHECK(read_all(in, len, 1000) == len);
+		CHECK(memcmp(in, out, len) == 0);
+		total += len;
+	}
+
+	const transport_stats *stats = cubemx_transport_get_stats();
+	CHECK(total > 4 * TEST_DMA_BUFFER);
+	CHECK(stats->bytes_out == total);
+	CHECK(stats->bytes_in == total);
+	CHECK(stats->rx_overruns == 0);
+	CHECK(stats->tx_rejects == 0);
+}
+
+static void test_overrun(void)
+{
+	static uint8_t burst[4 * TEST_DMA_BUFFER];
+	uint8_t in[4];
+	uint64_t echoed = peer.echoed;
+
+	cubemx_transport_reset_stats();
+
+	// nobody reads while the echo laps the DMA buffer
+	memset(burst, 0x55, sizeof(burst));
+	write_all(burst, sizeof(burst));
+	while (peer.echoed - echoed < sizeof(burst))
+	{
+		vTaskDelay(10);
+	}
+	vTaskDelay(100);
+
+	uint8_t err = 0;
+	CHECK(cubemx_transport_read(&transport, in, sizeof(in), 10, &err) == 0);
+	CHECK(cubemx_transport_get_stats()->rx_overruns == 1);
+
+	// the link carries on with the next data
+	write_all((const uint8_t *)"ping", 4);
+	CHECK(read_all(in, 4, 1000) == 4);
+	CHECK(memcmp(in, "ping", 4) == 0);
+}
+
+static void test_close_drains(void)
+{
+	static uint8_t out[TEST_TX_BUFFER];
+	uint64_t echoed = peer.echoed;
+
+	memset(out, 0xAA, sizeof(out));
+	write_all(out, sizeof(out));
+	CHECK(cubemx_transport_close(&transport));
+
+	// close returned after the last byte went out
+	vTaskDelay(50);
+	CHECK(peer.echoed - echoed == sizeof(out));
+}
+
+static void test_link_timeout(void)
+{
+	uint8_t in[4];
+	uint32_t negotiations = peer.negotiations;
+
+	// an agent that starts late stays at the agreed rate: the first open after the timeout tries it
+	vTaskDelay(TEST_LINK_MS);
+	CHECK(cubemx_transport_open(&transport));
+	CHECK(uart->Init.BaudRate == TEST_RATE);
+	CHECK(peer.negotiations == negotiations);
+	write_all((const uint8_t *)"late", 4);
+	CHECK(read_all(in, 4, 1000) == 4);
+	CHECK(memcmp(in, "late", 4) == 0);
+	CHECK(cubemx_transport_close(&transport));
+
+	// a restarted host listens at the default rate: one of the next two opens offers again
+	pty_peer_renegotiate(&peer);
+	vTaskDelay(TEST_LINK_MS);
+	for (int open = 0; (open < 2) && (peer.negotiations == negotiations); open++)
+	{
+		CHECK(cubemx_transport_open(&transport));
+		CHECK(cubemx_transport_close(&transport));
+	}
+	CHECK(peer.negotiations == negotiations + 1);
+	CHECK(uart->Init.BaudRate == TEST_RATE);
+}
+
+int main(void)
+{
+	uart = uart_pty_open(&pty, 115200);
+	CHECK(uart != NULL);
+	if ((uart == NULL) || (pty_peer_start(&peer, uart_pty_slave(&pty), TEST_RATE) != 0))
+	{
+		printf("no pty available\n");
+		return TEST_RESULT();
+	}
+	transport.args = uart;
+
+	test_negotiation();
+	test_loopback();
+	test_overrun();
+	test_close_drains();
+	test_link_timeout();
+
+	pty_peer_stop(&peer);
+	uart_pty_close(&pty);
+	return TEST_RESULT();
+}
@@ -0,0 +1,216 @@
+/*
+ * test_nrf24.c
+ *
+ *  NRF24 driver against a mock SPI bus that emulates the register file of the chip: the shadow
+ *  register cache saves SPI transactions on mode switches, and NRF24_Verify finds and repairs
+ *  registers that changed behind the driver's back.
+ */
+
+#include "NRF24L01.h"
+#include "test_check.h"
+#include <string.h>
+
+typedef struct{
+	uint8_t regs[32];
+	uint8_t addr[3][5];     /* RX_ADDR_P0, RX_ADDR_P1, TX_ADDR */
+	uint8_t cmd;            /* first byte of the current transaction */
+	uint32_t pos;           /* bytes into the current transaction */
+	uint32_t transactions;  /* CSN falling edges */
+	uint8_t ce;
+}mock_chip;
+
+static uint8_t *mock_addr(mock_chip *chip, uint8_t reg)
+{
+	if (reg == RX_ADDR_P0) return chip->addr[0];
+	if (reg == RX_ADDR_P1) return chip->addr[1];
+	if (reg == TX_ADDR) return chip->addr[2];
+	return NULL;
+}
+
+/* one byte of the transaction: STATUS is shifted out with the command, then the register data */
+static uint8_t mock_byte(mock_chip *chip, uint8_t in)
+{
+	uint8_t out = 0;
+
+	if (chip->pos == 0)
+	{
+		chip->cmd = in;
+		out = chip->regs[STATUS];
+	}
+	else
+	{
+		uint8_t reg = chip->cmd & REGISTER_MASK;
+		uint8_t *addr = mock_addr(chip, reg);
+		uint32_t i = (chip->pos - 1) % 5;
+
+		if ((chip->cmd & 0xE0) == R_REGISTER)
+		{
+			out = addr ? addr[i] : chip->regs[reg];
+		}
+		else if ((chip->cmd & 0xE0) == W_REGISTER)
+		{
+			if (addr)
+			{
+				addr[i] = in;
+			}
+			else
+			{
+				chip->regs[reg] = in;
+			}
+		}
+	}
+
+	chip->pos++;
+	return out;
+}
+
+static void mock_transfer(void *ctx, const uint8_t *tx, uint8_t *rx, uint16_t size)
+{
+	for (uint16_t i = 0; i < size; i++)
+	{
+		uint8_t out = mock_byte(ctx, tx ? tx[i] : NOP);
+
+		if (rx)
+		{
+			rx[i] = out;
+		}
+	}
+}
+
+static void mock_csn(void *ctx, uint8_t level)
+{
+	mock_chip *chip = ctx;
+
+	if (level == 0)
+	{
+		chip->pos = 0;
+		chip->transactions++;
+	}
+}
+
+static void mock_ce(void *ctx, uint8_t level)
+{
+	((mock_chip *)ctx)->ce = level;
+}
+
+static void mock_delay_ms(void *ctx, uint32_t ms)
+{
+	(void)ctx;
+	(void)ms;
+}
+
+static const nrf24_spi_ops mock_ops = {
+	.transfer = mock_transfer,
+	.csn = mock_csn,
+	.ce = mock_ce,
+	.delay_ms = mock_delay_ms,
+};
+
+static mock_chip chip;
+static nrf24_inst radio;
+
+/* radio configured like the command radio of main.c */
+static void setup(void)
+{
+	static const uint8_t legacy[1] = {0xEE};
+	static const uint8_t operator[1] = {0xF1};
+
+	memset(&chip, 0, sizeof(chip));
+	memset(&radio, 0, sizeof(radio));
+	memcpy(radio.address, (const uint8_t[5]){0xEE, 0xDD, 0xCC, 0xBB, 0xAA}, 5);
+	radio.channel = 10;
+	radio.ops = &mock_ops;
+	radio.ops_ctx = &chip;
+
+	NRF24_Init(&radio);
+	NRF24_RxMode(&radio);
+	NRF24_OpenRxPipe(&radio, 2, legacy, 32);
+	NRF24_OpenRxPipe(&radio, 5, operator, 0);
+	NRF24_EnableAckPayload(&radio);
+}
+
+static uint32_t transactions_of_rx_mode(void)
+{
+	uint32_t before = chip.transactions;
+
+	NRF24_RxMode(&radio);
+	return chip.transactions - before;
+}
+
+static void test_configuration(void)
+{
+	setup();
+
+	CHECK(chip.regs[RF_CH] == 10);
+	CHECK(chip.regs[CONFIG] & (1<<0));  /* PRIM_RX */
+	CHECK(chip.regs[CONFIG] & (1<<1));  /* PWR_UP */
+	CHECK(memcmp(chip.addr[1], radio.address, 5) == 0);
+	/* legacy pipe: static 32 byte payloads without auto acknowledge */
+	CHECK(chip.regs[RX_ADDR_P2] == 0xEE);
+	CHECK(chip.regs[RX_PW_P2] == 32);
+	CHECK(chip.regs[EN_RXADDR] & (1<<2));
+	CHECK(!(chip.regs[EN_AA] & (1<<2)));
+	CHECK(!(chip.regs[DYNPD] & (1<<2)));
+	/* binary frame pipe: dynamic payload length with auto acknowledge */
+	CHECK(chip.regs[RX_ADDR_P5] == 0xF1);
+	CHECK(chip.regs[EN_RXADDR] & (1<<5));
+	CHECK(chip.regs[EN_AA] & (1<<5));
+	CHECK(chip.regs[DYNPD] & (1<<5));
+	CHECK(chip.regs[FEATURE] == ((1<<2) | (1<<1)));
+	CHECK(chip.ce == 1);
+}
+
+static void test_shadow_cache(void)
+{
+	setup();
+
+	/* nothing changed: only the STATUS reset, which is never cached */
+	uint32_t cached = transactions_of_rx_mode();
+	CHECK(cached == 1);
+
+	/* without the cache every register is read and rewritten */
+	radio.shadow_valid = 0;
+	radio.shadow_addr_valid = 0;
+	uint32_t uncached = transactions_of_rx_mode();
+	CHECK(uncached > cached);
+
+	/* a mode switch back and forth only rewrites CONFIG once the addresses are known */
+	NRF24_TxMode(&radio);
+	NRF24_RxMode(&radio);
+	uint32_t before = chip.transactions;
+	NRF24_TxMode(&radio);
+	CHECK(chip.transactions - before == 1);
+	CHECK(!(chip.regs[CONFIG] & (1<<0)));
+	CHECK(memcmp(chip.addr[2], radio.address, 5) == 0);
+	CHECK(memcmp(chip.addr[0], radio.address, 5) == 0);
+	/* the ACK comes back on pipe 0 */
+	CHECK(chip.regs[EN_RXADDR] & (1<<0));
+	CHECK(chip.regs[EN_AA] & (1<<0));
+}
+
+static void test_verify(void)
+{
+	setup();
+	CHECK(NRF24_Verify(&radio, 0) == 0);
+
+	/* e.g. a brown-out of the radio: registers lost behind the driver's back */
+	chip.regs[RF_CH] = 2;
+	chip.addr[1][0] = 0xC2;
+	CHECK(NRF24_Verify(&radio, 0) == 2);
+	CHECK(chip.regs[RF_CH] == 2);
+
+	CHECK(NRF24_Verify(&radio, 1) == 2);
+	CHECK(chip.regs[RF_CH] == 10);
+	CHECK(memcmp(chip.addr[1], radio.address, 5) == 0);
+	CHECK(chip.ce == 1);
+	CHECK(NRF24_Verify(&radio, 0) == 0);
+}
+
+int main(void)
+{
+	test_configuration();
+	test_shadow_cache();
+	test_verify();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,113 @@
+/*
+ * test_radio_protocol.c
+ *
+ *  radio_decode: frame validation, duplicates and stale frames, with the sender clock drifting
+ *  against the rover clock.
+ */
+
+#include "radio_protocol.h"
+#include "test_check.h"
+#include <string.h>
+
+/* build a STOP frame, returns its length */
+static uint8_t stop_frame(uint8_t *buf, uint16_t seq, uint32_t timestamp_ms)
+{
+	radio_frame_header header = {
+		.magic = RADIO_FRAME_MAGIC,
+		.version = RADIO_FRAME_VERSION,
+		.type = RADIO_FRAME_STOP,
+		.seq = seq,
+		.timestamp_ms = timestamp_ms
+	};
+	uint8_t len = sizeof(header);
+
+	memcpy(buf, &header, len);
+	uint16_t crc = radio_crc16(buf, len);
+	buf[len] = crc & 0xFF;
+	buf[len + 1] = crc >> 8;
+	return len + 2;
+}
+
+static radio_status decode(radio_decoder *dec, uint16_t seq, uint32_t sender_ms, uint32_t now_ms)
+{
+	uint8_t buf[32];
+	const radio_frame_header *header;
+	const uint8_t *payload;
+	uint8_t len = stop_frame(buf, seq, sender_ms);
+
+	return radio_decode(dec, buf, len, now_ms, &header, &payload);
+}
+
+static void test_validation(void)
+{
+	radio_decoder dec = {0};
+	uint8_t buf[32];
+	const radio_frame_header *header;
+	const uint8_t *payload;
+	uint8_t len = stop_frame(buf, 1, 100);
+
+	radio_decoder_reset(&dec);
+	CHECK(radio_decode(&dec, buf, len - 1, 1000, &header, &payload) == radio_bad_length);
+	buf[len - 1] ^= 1;
+	CHECK(radio_decode(&dec, buf, len, 1000, &header, &payload) == radio_bad_crc);
+	buf[len - 1] ^= 1;
+	CHECK(radio_decode(&dec, buf, len, 1000, &header, &payload) == radio_ok);
+	CHECK(header == (const radio_frame_header *)buf);
+	CHECK(radio_decode(&dec, buf, len, 1010, &header, &payload) == radio_duplicate);
+	CHECK(decode(&dec, 0, 90, 1020) == radio_stale);
+}
+
+static void test_delay(void)
+{
+	radio_decoder dec = {0};
+
+	radio_decoder_reset(&dec);
+	CHECK(decode(&dec, 1, 0, 1000) == radio_ok);
+	CHECK(decode(&dec, 2, 20, 1020 + RADIO_STALE_MS / 2) == radio_ok);
+	CHECK(decode(&dec, 3, 40, 1040 + RADIO_STALE_MS + 1) == radio_stale);
+	CHECK(decode(&dec, 4, 60, 1060) == radio_ok);
+}
+
+/* sender clock 1 % slower than ours, one frame every 20 ms for a minute: no frame is stale */
+static void test_slow_sender(void)
+{
+	radio_decoder dec = {0};
+	uint32_t stale = 0;
+
+	radio_decoder_reset(&dec);
+	for (uint32_t i = 1; i <= 3000; i++)
+	{
+		uint32_t now = 1000 + i * 20;
+		uint32_t sender = i * 20 * 99 / 100;
+
+		stale += (decode(&dec, i, sender, now) != radio_ok);
+	}
+	CHECK(stale == 0);
+}
+
+/* sender clock faster than ours: the offsets keep falling, the minimum follows at once */
+static void test_fast_sender(void)
+{
+	radio_decoder dec = {0};
+	uint32_t stale = 0;
+
+	radio_decoder_reset(&dec);
+	for (uint32_t i = 1; i <= 3000; i++)
+	{
+		uint32_t now = 1000 + i * 20;
+		uint32_t sender = i * 20 * 101 / 100;
+
+		stale += (decode(&dec, i, sender, now) != radio_ok);
+	}
+	CHECK(stale == 0);
+}
+
+int main(void)
+{
+	test_validation();
+	test_delay();
+	test_slow_sender();
+	test_fast_sender();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,30 @@
+/*
+ * transport_host.c
+ *
+ *  The USART3 branches of the HAL UART callbacks of main.c.
+ */
+
+#include "transport_host.h"
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	(void)Size;
+
+	if (huart->Instance == USART3) {
+		cubemx_transport_rx_event(huart);
+	}
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if (huart->Instance == USART3) {
+		cubemx_transport_tx_complete(huart);
+	}
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if (huart->Instance == USART3) {
+		cubemx_transport_error(huart);
+	}
+}
@@ -0,0 +1,20 @@
+/*
+ * transport_host.h
+ *
+ *  The micro-ROS transport callbacks of dma_transport.c as main.c declares them, for the host
+ *  builds over uart_pty. transport_host.c wires the HAL UART callbacks to the transport like main.c.
+ */
+
+#ifndef TESTS_TRANSPORT_HOST_H_
+#define TESTS_TRANSPORT_HOST_H_
+
+#include <uxr/client/transport.h>
+#include <stdbool.h>
+#include "microros_transport.h"
+
+bool cubemx_transport_open(struct uxrCustomTransport * transport);
+bool cubemx_transport_close(struct uxrCustomTransport * transport);
+size_t cubemx_transport_write(struct uxrCustomTransport* transport, const uint8_t * buf, size_t len, uint8_t * err);
+size_t cubemx_transport_read(struct uxrCustomTransport* transport, uint8_t* buf, size_t len, int timeout, uint8_t* err);
+
+#endif /* TESTS_TRANSPORT_HOST_H_ */
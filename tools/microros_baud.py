@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Host side of the rover UART baud rate negotiation, then start the micro-ROS agent at the agreed rate.
+
+The rover offers its rates at the default 115200 baud when it opens the micro-ROS transport
+(see Core/Src/microros_transports/dma_transport.c):
+    rover: $BAUD?921600,2000000,3000000      host: $BAUD=<rate>
+    rover: $BAUD OK                          host (at <rate>): $BAUD!
+    rover (at <rate>): $BAUD!
+
+The rover negotiates once, then keeps the agreed rate across reconnections. Once it has received
+nothing for 2 s, its transport opens alternate: one at the agreed rate, the next one at the default
+rate with a new offer. An open lasts one agent ping or session attempt.
+
+Agent startup: this script never answers an offer again once it has exec'd the agent. The agent has to
+come up at the agreed rate, which it does however long it takes to start, since the rover keeps
+coming back to that rate. Restarting this script works the same way: it answers one of the offers
+made at the default rate. Stop the previous agent first, so that only one process holds the port.
+Otherwise, reset the rover.
+
+usage: microros_baud.py /dev/ttyACM0 [max rate, default 3000000] [extra agent arguments]
+Needs pyserial and micro-ros-agent in the PATH.
+"""
+
+import os
+import sys
+import time
+
+import serial
+
+DEFAULT_BAUD = 115200
+OFFER_TIMEOUT_S = 30
+
+
+def negotiate(port, max_rate):
+    with serial.Serial(port, DEFAULT_BAUD, timeout=0.5) as link:
+        deadline = time.monotonic() + OFFER_TIMEOUT_S
+        while time.monotonic() < deadline:
+            line = link.readline().strip()
+            if not line.startswith(b"$BAUD?"):
+                continue
+            rates = [int(r) for r in line[6:].split(b",") if r.isdigit() and int(r) <= max_rate]
+            if not rates:
+                return DEFAULT_BAUD
+            rate = max(rates)
+            link.write(b"$BAUD=%d\n" % rate)
+            reply = link.readline().strip()
+            if reply != b"$BAUD OK":
+                continue
+            link.flush()
+            link.baudrate = rate
+            time.sleep(0.01)
+            link.write(b"$BAUD!\n")
+            link.flush()
+            if link.readline().strip() == b"$BAUD!":
+                return rate
+            link.baudrate = DEFAULT_BAUD
+    return DEFAULT_BAUD
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    port = sys.argv[1]
+    max_rate = int(sys.argv[2]) if len(sys.argv) > 2 else 3000000
+    rate = negotiate(port, max_rate)
+    print("link at %d baud" % rate, file=sys.stderr)
+    agent = ["micro-ros-agent", "serial", "--dev", port, "-b", str(rate)] + sys.argv[3:]
+    os.execvp(agent[0], agent)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Decode the TLOG records mixed with plain text on the rover console (USART2).
+
+The format strings are not in the firmware image, they live in the .tlog_fmt section of the ELF
+and a record only carries the offset of its string in that section (see Core/Inc/tlog.h).
+
+usage: tlog_decode.py rover2.elf [capture file or serial device, default stdin]
+       e.g. stty -F /dev/ttyACM0 115200 raw && tlog_decode.py Debug/rover2.elf /dev/ttyACM0
+"""
+
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+TLOG_SYNC = 0x1E
+OBJCOPY = "arm-none-eabi-objcopy"
+SPEC = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXcfFeEgG%])")
+
+
+def load_strings(elf):
+    with tempfile.NamedTemporaryFile() as section:
+        subprocess.run([OBJCOPY, "--dump-section", ".tlog_fmt=" + section.name, elf, "/dev/null"],
+                       check=True)
+        return section.read()
+
+
+def format_record(strings, fmt_id, args):
+    end = strings.find(b"\0", fmt_id)
+    if fmt_id >= len(strings) or end < 0:
+        return "<tlog: unknown id %d %r>\n" % (fmt_id, args)
+    fmt = strings[fmt_id:end].decode("ascii", "replace")
+
+    values = []
+    raw = iter(args)
+
+    def convert(match):
+        flags, _, conv = match.groups()
+        if conv == "%":
+            return "%%"
+        word = next(raw, 0)
+        if conv in "fFeEgG":
+            values.append(struct.unpack("<f", struct.pack("<I", word))[0])
+        elif conv in "di":
+            values.append(struct.unpack("<i", struct.pack("<I", word))[0])
+        elif conv == "c":
+            values.append(chr(word & 0xFF))
+        else:
+            values.append(word)
+        return "%" + flags + ("d" if conv == "u" else conv)
+
+    return SPEC.sub(convert, fmt) % tuple(values)
+
+
+def decode(strings, stream, out):
+    while True:
+        byte = stream.read(1)
+        if not byte:
+            return
+        if byte[0] != TLOG_SYNC:
+            out.write(byte.decode("latin-1"))
+            continue
+        header = stream.read(3)
+        if len(header) < 3:
+            return
+        fmt_id, nargs = struct.unpack("<HB", header)
+        payload = stream.read(4 * nargs)
+        if len(payload) < 4 * nargs:
+            return
+        out.write(format_record(strings, fmt_id, struct.unpack("<%dI" % nargs, payload)))
+        out.flush()
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    strings = load_strings(sys.argv[1])
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], "rb", buffering=0) as stream:
+            decode(strings, stream, sys.stdout)
+    else:
+        decode(strings, sys.stdin.buffer, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+"""Unpack the rover "wheel_batch" messages into one line per control step.
+
+Each rover_msgs/WheelBatch carries the steps of all the wheels since the previous batch; the time of a
+step is stamp_ns + offset_us (agent clock once the rover synchronised). Output (CSV on stdout):
+    stamp_ns,wheel,counts,velocity,setpoint,duty,flags
+
+usage: wheel_batch_unpack.py [topic, default wheel_batch]
+Needs rclpy and rover_msgs built in the sourced workspace.
+"""
+
+import sys
+
+import rclpy
+from rclpy.qos import qos_profile_sensor_data
+from rover_msgs.msg import WheelBatch
+
+WHEELS = "abcd"
+
+
+def main():
+    topic = sys.argv[1] if len(sys.argv) > 1 else "wheel_batch"
+    rclpy.init()
+    node = rclpy.create_node("wheel_batch_unpack")
+    dropped = [0]
+
+    def on_batch(msg):
+        if msg.dropped != dropped[0]:
+            sys.stderr.write("rover dropped %d samples\n" % (msg.dropped - dropped[0]))
+            dropped[0] = msg.dropped
+        for s in msg.samples:
+            print("%d,%s,%d,%.3f,%.3f,%.2f,%d" % (msg.stamp_ns + s.offset_us * 1000, WHEELS[s.wheel], s.counts,
+                                                  s.velocity, s.setpoint, s.duty, s.flags))
+
+    node.create_subscription(WheelBatch, topic, on_batch, qos_profile_sensor_data)
+    print("stamp_ns,wheel,counts,velocity,setpoint,duty,flags")
+    try:
+        rclpy.spin(node)
+    except KeyboardInterrupt:
+        pass
+    node.destroy_node()
+    rclpy.shutdown()
+
+
+if __name__ == "__main__":
+    main()